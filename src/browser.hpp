@@ -0,0 +1,30 @@
+#pragma once
+#include "common.hpp"
+#include <memory>
+
+namespace Textures {
+struct ObjectClass;
+}
+
+// Folder tree of the object classes under objects/, kept in memory so the Objects window never touches the disk. Built
+// at load, then updated as classes and folders are created here or show up on disk
+namespace Browser {
+struct Folder {
+  std::string name, sortKey;
+  Folder* parent = nullptr;
+  vector<std::unique_ptr<Folder>> folders;  // Both sorted by sortKey
+  vector<Textures::ObjectClass*> objects;
+
+  fs::path path() const;
+};
+
+extern Folder root;
+extern Folder* current;
+
+void rebuild();
+Folder* folder(const fs::path& path);
+void add(Textures::ObjectClass* object);
+
+// Best matches first, ties in sorted order. Narrowing the previous query only rescans its matches
+const vector<Textures::ObjectClass*>& search(const std::string& query);
+}  // namespace Browser
@@ -0,0 +1,200 @@
+#include "assets.hpp"
+#include <cerrno>
+#include <cstdint>
+#include <unordered_set>
+
+namespace Textures {
+vector<Atlas*> atlases;
+vector<ObjectClass*> objects;
+Registry<Atlas> atlasNames;
+Registry<ObjectClass> objectNames;
+static vector<std::string> missing;
+static std::mutex missingMutex;
+
+void reportMissing(const std::string& message) {
+  std::lock_guard<std::mutex> lock(missingMutex);
+  missing.push_back(message);
+}
+
+vector<std::string> takeMissing() {
+  std::lock_guard<std::mutex> lock(missingMutex);
+  std::sort(missing.begin(), missing.end());
+  return std::move(missing);
+}
+
+Atlas* atlasByName(const std::string& name, const std::string& referrer) {
+  if (auto atlas = atlasNames.find(name)) return atlas;
+  reportMissing(format("%s: atlas %s", referrer.c_str(), name.c_str()));
+  return atlases.empty() ? nullptr : atlases[0];
+}
+
+static bool bySortKey(ObjectClass* a, ObjectClass* b) { return a->sortKey < b->sortKey; }
+
+void add(ObjectClass* object) {
+  if (!objectNames.add(object)) reportMissing("Duplicate object class " + object->name + " in " + object->path.string());
+  objects.insert(std::upper_bound(objects.begin(), objects.end(), object, bySortKey), object);
+  reindex(objects);
+}
+
+bool parseValue(PropertyType type, const std::string& text, Value& value) {
+  value.i = 0;
+  const char* begin = text.c_str();
+  char* end = nullptr;
+  if (type == PropertyType::STRING) return value.s = Strings::intern(text), true;
+  errno = 0;
+  if (type == PropertyType::INT) {
+    long long parsed = strtoll(begin, &end, 10);  // Decimal only, "010" is ten as it always was
+    if (errno == ERANGE || parsed < INT32_MIN || parsed > INT32_MAX) return false;
+    value.i = parsed;
+  } else value.f = strtof(begin, &end);
+  if (end == begin && !text.empty() || *end != '\0') return value.i = 0, false;
+  return true;
+}
+
+std::string formatValue(PropertyType type, Value value) {
+  if (type == PropertyType::INT) return std::to_string(value.i);
+  if (type == PropertyType::FLOAT) return format("%.9g", value.f);  // Enough digits to read back the same float
+  return Strings::get(value.s);
+}
+
+void save(vector<Saver::Job>& jobs) {
+  for (const auto atlas : atlases) {
+    if (atlas->dirty) atlas->save(jobs);
+  }
+  for (const auto object : objects) {
+    if (object->dirty) object->save(jobs);
+  }
+}
+
+void load() {
+  {  // Atlases
+    for (const auto atlas : atlases) delete atlas;
+    atlases.clear();
+    atlasNames.clear();
+    vector<std::string> names;
+    for (const auto& entry : fs::directory_iterator(projectSaveDirectory + "atlases/")) {
+      if (entry.path().extension() == ".png") names.push_back(entry.path().stem().string());
+    }
+    std::sort(names.begin(), names.end(), [](const std::string& a, const std::string& b) { return strcmp(a, b); });
+    Project::toLoad += names.size();
+    atlases.resize(names.size());
+    Jobs::parallelFor(names.size(), [&](size_t i) { atlases[i] = new Atlas(names[i]), Project::loaded++; });
+    for (const auto atlas : atlases) atlasNames.add(atlas);
+    reindex(atlases);
+  }
+
+  {  // Objects, after atlases since they resolve theirs by name
+    for (const auto object : objects) delete object;
+    objects.clear();
+    objectNames.clear();
+    vector<std::string> paths;
+    for (const auto& p : fs::recursive_directory_iterator(projectSaveDirectory + "objects/")) {
+      if (!p.is_directory()) paths.push_back(p.path().string());
+    }
+    std::sort(paths.begin(), paths.end());
+    Project::toLoad += paths.size();
+    objects.resize(paths.size());
+    Jobs::parallelFor(paths.size(), [&](size_t i) { objects[i] = new ObjectClass(paths[i]), Project::loaded++; });
+    for (const auto object : objects) {
+      if (!objectNames.add(object)) reportMissing("Duplicate object class " + object->name + " in " + object->path.string());
+    }
+    std::stable_sort(objects.begin(), objects.end(), bySortKey);
+    reindex(objects);
+  }
+}
+
+std::string exportData(ExportOrder pixels, bool stripUnused) {
+  std::string data = pixels == ExportOrder::ROWS ? "" : format("#define ORE_TEXTURES_LAYOUT %d\n", (int)pixels);
+  data += "const uint8_t PROGMEM textures[] = {\n  ";
+
+  data += itobytes(atlases.size(), 2);
+  for (auto atlas : atlases) {
+    int nTiles = atlas->width() * atlas->height();
+    vector<int> exported = stripUnused ? TiledLevel::exportedTiles(atlas) : vector<int>();
+    auto kept = [&](int tile) { return !stripUnused || exported[tile] != -1; };
+    data += format("%d, %d, %d, ", stripUnused ? (int)std::count_if(exported.begin(), exported.end(), [](int index) { return index != -1; }) : nTiles, atlas->tilesize.x, atlas->tilesize.y);
+    // Tiles are formatted once and kept until the atlas changes, painting drops just the tiles it touches
+    auto& cache = atlas->exportCache;
+    if (cache.revision != atlas->revision || cache.tilesize != atlas->tilesize || cache.order != pixels || cache.tiles.size() != nTiles) {
+      cache = {atlas->revision, atlas->tilesize, pixels, vector<std::string>(nTiles)};
+    }
+    int tilePixels = atlas->tilesize.x * atlas->tilesize.y;
+    for (int i = 0; i < nTiles; i++) {
+      if (!kept(i)) continue;
+      std::string& tile = cache.tiles[i];
+      if (tile.empty()) {
+        MvImage& image = atlas->image();
+        for (int j = 0; j < tilePixels; j++) {
+          int x = pixels == ExportOrder::ROWS ? j % atlas->tilesize.x : j / atlas->tilesize.y;
+          int y = pixels == ExportOrder::ROWS ? j / atlas->tilesize.x : j % atlas->tilesize.y;
+          uint16_t pixel = rgb565(image.getPixel(i * atlas->tilesize.x % image.width + x, i * atlas->tilesize.x / image.width * atlas->tilesize.y + y));
+          tile += format("%d, %d, ", pixel >> 8, pixel & 0xff);
+        }
+      }
+      data += tile;
+    }
+    atlas->account();
+    data += format("%d, ", atlas->tileset != nullptr);
+    if (atlas->tileset) {
+      vector<vec2i> patches;
+      for (const auto& patch : atlas->tileset->patches) {
+        if (kept(atlas->toIndex(patch))) patches.push_back(patch);
+      }
+      data += format("%d, ", patches.size());
+      for (const auto& patch : patches) {
+        data += format("%d, ", (stripUnused ? exported[atlas->toIndex(patch)] : atlas->toIndex(patch)) + 1);
+      }
+      data += format("%d, ", atlas->tileset->colliders != nullptr);
+      if (atlas->tileset->colliders) {
+        vector<bool> colliders;
+        for (int i = 0; i < nTiles; i++) {
+          if (kept(i)) colliders.push_back(atlas->tileset->colliders[i]);
+        }
+        int tilesTotal = colliders.size();
+        for (int i = 0; i < tilesTotal / 8 + (tilesTotal % 8 != 0); i++) {
+          uint8_t byte = 0;
+          for (int j = 0; j < 8; j++) {
+            if (i * 8 + j < tilesTotal) byte |= colliders[i * 8 + j] << j;
+          }
+          data += format("%d, ", byte);
+        }
+      }
+    }
+  }
+  data += itobytes(objects.size(), 2);
+  for (const auto object : objects) {
+    data += itobytes(object->atlas->index, 2);
+  }
+  for (int i = 0; i < 2; i++) data.pop_back();
+  data += "\n};";
+  return data;
+}
+
+void commitEdits(Atlas* atlas) {
+  if (atlas->editedTiles.empty()) return;
+  PROFILE("Textures::commitEdits");
+  bool colors = atlas->colorsRevision == atlas->revision && atlas->colors.size() == atlas->width() * atlas->height();
+  if (colors) {
+    for (vec2i tile : atlas->editedTiles) atlas->averageTile(atlas->image(), atlas->toIndex(tile));
+  }
+  // Minimaps of the levels showing a painted tile get those pixels again, a row per job, and are uploaded whole once
+  for (const auto level : TiledLevel::levels) {
+    if (!colors || level->tileset != atlas || !level->minimap || level->minimapTileset != atlas || level->minimapTilesetRevision != atlas->revision) continue;
+    std::unordered_set<uint32_t> painted;
+    for (vec2i tile : atlas->editedTiles) {
+      if (level->uses(tile)) painted.insert(TiledLevel::Level::usageKey(tile));
+    }
+    if (painted.empty()) continue;
+    vec2i* tiles = level->tiles();
+    int step = level->minimapStep();
+    Jobs::parallelFor(level->minimap->height, [&](size_t y) {
+      for (int x = 0; x < level->width; x += step) {
+        vec2i tile = tiles[x + y * step * level->width];
+        if (tile != -1 && painted.count(TiledLevel::Level::usageKey(tile))) level->drawMinimap(vec2i(x, y * step), tile);
+      }
+    });
+    level->minimapRevision++;
+  }
+  atlas->editedTiles.clear();
+}
+}  // namespace Textures
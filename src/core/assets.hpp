@@ -0,0 +1,810 @@
+#pragma once
+#include "base.hpp"
+#include "cache.hpp"
+#include "jobs.hpp"
+#include "saver.hpp"
+#include "journal.hpp"
+#include "history.hpp"
+#include "registry.hpp"
+#include "strings.hpp"
+#include "profiler.hpp"
+#include "memory.hpp"
+#include "texturecache.hpp"
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+
+// The project model: atlases, object classes and levels, how they're read, saved and exported. Nothing here needs a
+// window, the editor and the command line tools share it
+extern std::string projectSaveDirectory;
+
+// Order of tile pixels and level cells in the flat exports. ROWS is the original layout, anything else is announced with
+// ORE_TEXTURES_LAYOUT / ORE_LEVELS_LAYOUT defined to the value, so firmware can stream a column in one read
+enum class ExportOrder : uint8_t { ROWS, COLUMNS };
+const std::string exportOrders[] = {"rows", "columns"};
+
+inline bool parseExportOrder(const std::string& name, ExportOrder& order) {
+  auto it = std::find(std::begin(exportOrders), std::end(exportOrders), name);
+  if (it == std::end(exportOrders)) return false;
+  order = ExportOrder(it - std::begin(exportOrders));
+  return true;
+}
+
+namespace TiledLevel {
+struct Object;
+}
+
+namespace Textures {
+struct Atlas : Cache::Asset {
+  vec2i tilesize, imageSize;
+  std::string name, source;
+  std::unique_ptr<MvImage> pixels;
+  uint32_t id = 0, index = 0;
+  uint32_t revision = 0;  // Bumped whenever the pixels change, anything cached from them compares against it
+  Memory::Account memory;
+  vector<MvColor> colors;  // Average of each tile's opaque pixels, what minimaps draw it with
+  uint32_t colorsRevision = -1;
+  bool edited = false;        // Painted since the PNG was last written
+  vector<vec2i> editedTiles;  // Painted since the last Textures::commitEdits
+  // Each tile's pixels as the flat export writes them, filled by Textures::exportData and dropped per tile when painted
+  struct ExportCache {
+    uint32_t revision = -1;
+    vec2i tilesize = 0;
+    ExportOrder order = ExportOrder::ROWS;
+    vector<std::string> tiles;
+
+    size_t bytes() const {
+      size_t bytes = tiles.capacity() * sizeof(std::string);
+      for (const auto& tile : tiles) bytes += tile.capacity();
+      return bytes;
+    }
+  } exportCache;
+  // Where Packer put each sprite it was built from, kept in <name>.spr next to the PNG
+  struct Sprite {
+    std::string name;
+    vec2i tile, tiles;   // First tile and how many it spans
+    vec2i offset, size;  // Where the trimmed pixels were in the source image, and its size
+  };
+  vector<Sprite> sprites;
+  struct Tileset {
+    vector<vec2i> patches;
+    bool* colliders = nullptr;
+
+    vec2i patch(vec2i tile) {
+      for (const auto& patch : patches) {
+        if (inRangeW(tile.x, patch.x, 4) && tile.y == patch.y) return patch;
+      }
+      return -1;
+    }
+
+    bool inPatch(vec2i tile) { return patch(tile) != -1; }
+
+    void removePatch(vec2i tile) {
+      for (int i = 0; i < patches.size(); i++) {
+        if (inRangeW(tile.x, patches[i].x, 4) && tile.y == patches[i].y) {
+          patches.erase(patches.begin() + i);
+          break;
+        }
+      }
+    }
+  }* tileset = nullptr;
+
+  Atlas(const std::string& filename, vec2i tilesize) : tilesize(tilesize), imageSize(pngSize(filename)), source(filename) { dirty = true; }
+  // Pixels that only exist in memory, their PNG is written with the rest of the atlas on the next save
+  Atlas(std::unique_ptr<MvImage> image, vec2i tilesize) : tilesize(tilesize), imageSize(image->size()), pixels(std::move(image)) {
+    edited = dirty = true;
+    account();
+  }
+  Atlas(const std::string& name) : name(name), source(pngPath(name)) {
+    imageSize = pngSize(source);
+    File file(projectSaveDirectory + "atlases/" + name + ".atl", "rb");
+    if (!file()) throw std::runtime_error("Can't read atlas " + name + ".atl");
+    fread((void*)&tilesize, sizeof(tilesize), 1, file());
+    if (fgetn<bool>(file())) {
+      tileset = new Tileset();
+      int nPatches = fgetn<uint16_t>(file());
+      tileset->patches.resize(nPatches);
+      if (nPatches) fread((void*)&tileset->patches[0], sizeof(tileset->patches[0]), nPatches, file());
+      if (fgetn<bool>(file())) {
+        tileset->colliders = new bool[width() * height()];
+        uint32_t w, h;
+        readMetadata(file(), "%32i %32i", &w, &h);
+        bool* readColliders = new bool[w * h];
+        fread((void*)readColliders, sizeof(tileset->colliders[0]), w * h, file());
+        for (int x = 0; x < min(w, width()); x++) {
+          for (int y = 0; y < min(h, height()); y++) {
+            tileset->colliders[x + y * width()] = readColliders[x + y * w];
+          }
+        }
+        delete[] readColliders;
+      }
+    }
+
+    File spriteFile(projectSaveDirectory + "atlases/" + name + ".spr", "rb");
+    if (spriteFile()) {
+      sprites.resize(fgetn<uint16_t>(spriteFile()));
+      for (auto& sprite : sprites) {
+        readMetadata(spriteFile(), "%s %32i %32i %32i %32i %32i %32i %32i %32i", &sprite.name, &sprite.tile.x, &sprite.tile.y, &sprite.tiles.x, &sprite.tiles.y, &sprite.offset.x, &sprite.offset.y, &sprite.size.x, &sprite.size.y);
+      }
+    }
+  }
+
+  const Sprite* sprite(const std::string& name) const {
+    for (const auto& sprite : sprites) {
+      if (sprite.name == name) return &sprite;
+    }
+    return nullptr;
+  }
+
+  ~Atlas() {
+    TextureCache::release(this);
+    if (tileset) {
+    if (tileset->colliders) delete[] tileset->colliders;
+      delete tileset;
+    }
+  }
+
+  static std::string pngPath(const std::string& name) { return projectSaveDirectory + "atlases/" + name + ".png"; }
+
+  // Pixels are decoded on first use and may be dropped again by Cache::trim
+  MvImage& image() {
+    if (!pixels) pixels = std::make_unique<MvImage>(source), account();
+    touch();
+    return *pixels;
+  }
+
+  // The PNG was changed on disk, everything holding on to this atlas keeps working
+  // Throws, with nothing changed, if the PNG can't be read, such as while it's still being written
+  void reload() {
+    vec2i oldSize = size(), newSize = pngSize(source);
+    if (newSize.x <= 0 || newSize.y <= 0) throw std::runtime_error("Can't read " + source);
+    imageSize = newSize;
+    if (tileset && tileset->colliders && size() != oldSize) {
+      bool* colliders = new bool[width() * height()]();
+      for (int x = 0; x < min(oldSize.x, width()); x++) {
+        for (int y = 0; y < min(oldSize.y, height()); y++) {
+          colliders[x + y * width()] = tileset->colliders[x + y * oldSize.x];
+        }
+      }
+      delete[] tileset->colliders;
+      tileset->colliders = colliders;
+      dirty = true;
+    }
+    if (pixels) pixels = std::make_unique<MvImage>(source);
+    edited = false, editedTiles.clear();
+    revision++;
+    account();
+  }
+
+  // Leaves the pixels as resident as they were
+  const vector<MvColor>& tileColors() {
+    if (colorsRevision == revision && colors.size() == width() * height()) return colors;
+    bool wasResident = resident();
+    MvImage& image = this->image();
+    colors.resize(width() * height());
+    for (int i = 0; i < colors.size(); i++) averageTile(image, i);
+    if (!wasResident) evict();
+    colorsRevision = revision;
+    return colors;
+  }
+
+  void averageTile(MvImage& image, int index) {
+    vec2i start = vec2i(index % width(), index / width()) * tilesize;
+    uint32_t r = 0, g = 0, b = 0, opaque = 0;
+    for (int y = start.y; y < start.y + tilesize.y; y++) {
+      for (int x = start.x; x < start.x + tilesize.x; x++) {
+        MvColor pixel = image.getPixel(x, y);
+        if (pixel.a) r += pixel.r, g += pixel.g, b += pixel.b, opaque++;
+      }
+    }
+    colors[index] = opaque ? MvColor(r / opaque, g / opaque, b / opaque) : MvColor(0, 0, 0, 0);
+  }
+
+  // Only the pixel's tile is sent to the GPU again, on every paint since the texture may have been drawn in between.
+  // Caches built from the tile catch up in Textures::commitEdits
+  void paint(vec2i pos, MvColor color) {
+    if (!inRange(pos.x, 0, imageSize.x) || !inRange(pos.y, 0, imageSize.y)) return;
+    image().setPixel(pos.x, pos.y, color);
+    vec2i tile = pos / tilesize;
+    if (std::find(editedTiles.begin(), editedTiles.end(), tile) == editedTiles.end()) editedTiles.push_back(tile);
+    TextureCache::markDirty(this, tile * tilesize, tilesize);
+    if (exportCache.tiles.size() > toIndex(tile)) exportCache.tiles[toIndex(tile)].clear();
+    edited = dirty = true;
+  }
+
+  bool resident() const override { return pixels != nullptr; }
+  size_t residentBytes() const override { return imageSize.x * imageSize.y * sizeof(MvColor); }
+  void evict() override { pixels.reset(), account(); }
+
+  // TEXTURES is charged by TextureCache, the texture outlives the pixels
+  void account() {
+    memory.set(Memory::IMAGES, (pixels ? residentBytes() : 0) + exportCache.bytes());
+    memory.set(Memory::COLLIDERS, tileset && tileset->colliders ? width() * height() * sizeof(bool) : 0);
+  }
+
+  void save(vector<Saver::Job>& jobs) {
+    if (source != pngPath(name) || edited) {  // Imported, renamed or painted, otherwise the PNG on disk is already up to date
+      MvImage& image = this->image();
+      auto copy = std::make_shared<MvImage>(imageSize, nullptr);
+      copy->clear(MvColor::alpha);
+      copy->drawImage(image, 0, imageSize, 0, imageSize);
+      // The pixels are still read from the old source until the new PNG is there
+      jobs.push_back({pngPath(name), [copy](const std::string& tmp) { copy->save(tmp); }, [this, png = pngPath(name)](bool written) {
+        if (written) source = png;
+        else edited = dirty = true;
+      }});
+      edited = false;
+    }
+
+    bool hasTileset = tileset, hasColliders = tileset && tileset->colliders;
+    vector<vec2i> patches = hasTileset ? tileset->patches : vector<vec2i>();
+    vector<bool> colliders = hasColliders ? vector<bool>(tileset->colliders, tileset->colliders + width() * height()) : vector<bool>();
+    jobs.push_back({projectSaveDirectory + "atlases/" + name + ".atl", [=, tilesize = tilesize, size = size()](const std::string& tmp) {
+      File file(tmp, "wb+");
+      fwrite((void*)&tilesize, sizeof(tilesize), 1, file());
+      fputn<bool>(file(), hasTileset);
+      if (hasTileset) {
+        fputn<uint16_t>(file(), patches.size());
+        if (!patches.empty()) fwrite((void*)&patches[0], sizeof(patches[0]), patches.size(), file());
+        fputn<bool>(file(), hasColliders);
+        if (hasColliders) {
+          writeMetadata(file(), "%32i %32i", size.x, size.y);
+          for (bool collider : colliders) fputn<bool>(file(), collider);
+        }
+      }
+    }, [this](bool written) { dirty |= !written; }});
+    if (!sprites.empty()) {
+      jobs.push_back({projectSaveDirectory + "atlases/" + name + ".spr", [sprites = sprites](const std::string& tmp) {
+        File file(tmp, "wb+");
+        fputn<uint16_t>(file(), sprites.size());
+        for (const auto& sprite : sprites) {
+          writeMetadata(file(), "%s %32i %32i %32i %32i %32i %32i %32i %32i", sprite.name.c_str(), sprite.tile.x, sprite.tile.y, sprite.tiles.x, sprite.tiles.y, sprite.offset.x, sprite.offset.y, sprite.size.x, sprite.size.y);
+        }
+      }, [this](bool written) { dirty |= !written; }});
+    }
+    dirty = false;
+  }
+
+  int width() const { return imageSize.x / tilesize.x; }
+  int height() const { return imageSize.y / tilesize.y; }
+  vec2i size() const { return vec2i(width(), height()); }
+  int toIndex(vec2i tile) const { return tile.x + tile.y * width(); }
+};
+
+extern vector<Atlas*> atlases;
+extern Registry<Atlas> atlasNames;
+
+// Broken references found while loading, and level tiles that couldn't be read back, collected from any thread
+void reportMissing(const std::string& message);
+vector<std::string> takeMissing();
+
+// Reports a missing atlas and falls back to the first one, so whoever refers to it stays usable
+Atlas* atlasByName(const std::string& name, const std::string& referrer);
+
+enum class PropertyType : uint8_t { INT, FLOAT, STRING };
+const std::string propertyTypes[] = {"int", "float", "String"};
+
+// Instance property values are stored in 32 bits, strings as an id from Strings
+union Value {
+  int32_t i;
+  float f;
+  uint32_t s;
+};
+
+// False if text isn't a valid value of that type, value is zero then
+bool parseValue(PropertyType type, const std::string& text, Value& value);
+std::string formatValue(PropertyType type, Value value);
+
+struct ObjectClass {
+  Textures::Atlas* atlas;
+  std::string name, sortKey;
+  fs::path path;
+  uint32_t id = 0, index = 0;
+
+  struct Property {
+    std::string name, defaultValue;
+    PropertyType type = PropertyType::INT;
+    vector<Value> column;  // Value of this property for every instance, indexed by TiledLevel::Object::row
+
+    Value parsedDefault() const {
+      Value value;
+      parseValue(type, defaultValue, value);
+      return value;
+    }
+  };
+
+  std::vector<Property> properties;
+  uint32_t rows = 0;
+  vector<uint32_t> freeRows;
+  std::mutex rowsMutex;  // Levels are parsed in parallel
+  bool dirty = false;
+  Memory::Account memory;
+
+  ObjectClass(const std::string& name, const fs::path& path, Atlas* atlas) : name(name), path(path), atlas(atlas), sortKey(naturalKey(name)) { dirty = true; }
+  ObjectClass(const std::string& path) : name(path.substr(path.find_last_of("/\\") + 1, path.size() - path.find_last_of("/\\") - 5)), path(path) {
+    sortKey = naturalKey(this->name);
+    read();
+  }
+
+  // Also used on hot reload, where properties are matched to the ones already there by name, so the instances keep their
+  // values however the file reordered, inserted or retyped them. Only new ones get their default. Throws, with nothing
+  // changed, if the file is gone or cut short
+  void read() {
+    File file(path.string(), "rb");
+    if (!file()) throw std::runtime_error("Can't read object class " + path.string());
+    std::string atlasName = freadstr(file());
+    uint32_t nProps = fgetn<uint32_t>(file());
+    vector<Property> read;
+    for (uint32_t i = 0; i < nProps && !feof(file()); i++) {
+      Property& property = read.emplace_back();
+      readMetadata(file(), "%s, %s, %8i", &property.name, &property.defaultValue, &property.type);
+    }
+    if (feof(file()) || ferror(file())) throw std::runtime_error("Object class " + path.string() + " is cut short");
+
+    atlas = atlasByName(atlasName, "Object class " + name);
+    vector<bool> taken(properties.size());
+    for (auto& property : read) {
+      int old = 0;
+      while (old < properties.size() && (taken[old] || properties[old].name != property.name)) old++;
+      if (old == properties.size() || properties[old].column.size() != rows) {
+        property.column.assign(rows, property.parsedDefault());
+        continue;
+      }
+      taken[old] = true;
+      property.column = std::move(properties[old].column);
+      if (property.type != properties[old].type) convert(property, properties[old].type);
+    }
+    properties = std::move(read);
+  }
+
+  uint32_t allocRow(const Value* values = nullptr) {
+    std::lock_guard<std::mutex> lock(rowsMutex);
+    uint32_t row;
+    if (!freeRows.empty()) row = freeRows.back(), freeRows.pop_back();
+    else {
+      row = rows++;
+      for (auto& property : properties) property.column.emplace_back();
+    }
+    for (int i = 0; i < properties.size(); i++) properties[i].column[row] = values ? values[i] : properties[i].parsedDefault();
+    return row;
+  }
+
+  uint32_t copyRow(uint32_t row) {
+    vector<Value> values;
+    for (const auto& property : properties) values.push_back(property.column[row]);
+    return allocRow(values.data());
+  }
+
+  void freeRow(uint32_t row) {
+    std::lock_guard<std::mutex> lock(rowsMutex);
+    freeRows.push_back(row);
+  }
+
+  uint32_t instances() const { return rows - freeRows.size(); }
+
+  void account() {
+    size_t bytes = freeRows.capacity() * sizeof(uint32_t);
+    for (const auto& property : properties) bytes += property.column.capacity() * sizeof(Value);
+    memory.set(Memory::OBJECTS, bytes);
+  }
+
+  void addProperty() {
+    properties.emplace_back();
+    properties.back().column.assign(rows, properties.back().parsedDefault());
+  }
+
+  void setType(int property, PropertyType type) {
+    std::swap(properties[property].type, type);
+    convert(properties[property], type);
+  }
+
+  static void convert(Property& property, PropertyType from) {
+    for (auto& value : property.column) parseValue(property.type, formatValue(from, value), value);
+  }
+
+  void save(vector<Saver::Job>& jobs) {
+    struct Saved {
+      std::string name, defaultValue;
+      PropertyType type;
+    };
+    vector<Saved> saved;
+    for (const auto& property : properties) saved.push_back({property.name, property.defaultValue, property.type});
+    jobs.push_back({path.string(), [atlasName = atlas->name, properties = std::move(saved)](const std::string& tmp) {
+      File file(tmp, "wb+");
+      fwritestr(file(), atlasName.c_str());
+      fputn<uint32_t>(file(), properties.size());
+      for (const auto& property : properties) {
+        writeMetadata(file(), "%s, %s, %8i", property.name.c_str(), property.defaultValue.c_str(), property.type);
+      }
+    }, [this](bool written) { dirty |= !written; }});
+    dirty = false;
+  }
+};
+extern std::vector<ObjectClass*> objects;
+extern Registry<ObjectClass> objectNames;
+
+// Registers a new class and puts it at its sorted place
+void add(ObjectClass* object);
+void save(vector<Saver::Job>& jobs);
+void load();
+// stripUnused leaves out tiles no level uses, see TiledLevel::exportedTiles
+std::string exportData(ExportOrder pixels = ExportOrder::ROWS, bool stripUnused = false);
+// Brings the tile colors, export cache and level minimaps up to date with the tiles painted since the last call
+void commitEdits(Atlas* atlas);
+}  // namespace Textures
+
+namespace TiledLevel {
+struct Object {
+  static constexpr uint32_t NO_ROW = -1;
+
+  vec2i pos;
+  Textures::ObjectClass* parent = nullptr;
+  uint32_t row = NO_ROW;  // Where our property values are in the parent's columns
+
+  Object(){};
+  Object(Textures::ObjectClass* parent, vec2i pos, const Textures::Value* values = nullptr) : pos(pos), parent(parent), row(parent->allocRow(values)) {}
+  Object(const Object& other) : pos(other.pos), parent(other.parent), row(other.parent ? other.parent->copyRow(other.row) : NO_ROW) {}
+  Object(Object&& other) noexcept : pos(other.pos), parent(other.parent), row(std::exchange(other.row, NO_ROW)) {}
+
+  Object& operator=(const Object& other) {
+    if (this == &other) return *this;
+    release();
+    pos = other.pos, parent = other.parent, row = other.parent ? other.parent->copyRow(other.row) : NO_ROW;
+    return *this;
+  }
+
+  Object& operator=(Object&& other) noexcept {
+    if (this == &other) return *this;
+    release();
+    pos = other.pos, parent = other.parent, row = std::exchange(other.row, NO_ROW);
+    return *this;
+  }
+
+  ~Object() { release(); }
+
+  void release() {
+    if (parent && row != NO_ROW) parent->freeRow(row);
+    row = NO_ROW;
+  }
+
+  Textures::Value& property(int index) { return parent->properties[index].column[row]; }
+  const Textures::Value& property(int index) const { return parent->properties[index].column[row]; }
+};
+
+// .lvl files from version 2 on keep tiles row by row. A row is a run count then, per run, its length and its tile as the
+// difference from the run before, or a run count of 0 when it's the same as the row above
+std::string encodeTiles(const vec2i* tiles, uint32_t width, uint32_t height);
+// Reads bytes of encodeTiles() from file a block at a time into grid, row is called as each row is done. Without a grid
+// only two rows are kept, for a caller that just looks at them. False if the data is cut short or corrupt, the rows
+// not read are then empty
+bool decodeTiles(FILE* file, uint32_t bytes, uint32_t width, uint32_t height, vec2i* grid, const std::function<void(const vec2i* row, uint32_t y)>& row = nullptr);
+
+struct Level : Cache::Asset {
+  static constexpr uint32_t FILE_MAGIC = 0x4c564c4f;  // "OLVL", version 1 files have none and start with the width
+  static constexpr uint16_t FILE_VERSION = 3;
+
+  Textures::Atlas* tileset;
+  uint32_t width, height;
+  std::string name;
+  vec2i* data = nullptr;
+  long dataOffset = 0;  // Of the raw tiles in version 1, of the encoded size and encodeTiles() after it from version 2
+  uint16_t version = FILE_VERSION;
+  bool unreadable = false;  // The tiles couldn't be read back, the empty grid in their place is never saved over the file
+  std::vector<Object> objects;
+  Memory::Account memory;
+  std::unordered_map<uint32_t, uint32_t> usage;  // Cells showing each tile by usageKey(), kept while the tiles aren't resident
+  uint32_t usageRevision = 0;  // Bumped whenever usage changes, for what's cached from it
+  // A pixel per minimapStep() cells, in the tile color of the cell at its top left, so no side is over MINIMAP_SIZE. Kept
+  // while the tiles aren't resident and counted against Cache::budget. Drawn by minimapImage() when first shown and again
+  // when the tileset or its pixels changed, single pixels are marked dirty in TextureCache under &minimap
+  static constexpr uint32_t MINIMAP_SIZE = 160;
+  std::unique_ptr<MvImage> minimap;
+  const Textures::Atlas* minimapTileset = nullptr;
+  uint32_t minimapRevision = 0, minimapTilesetRevision = 0;
+
+  // Only the header, tile counts and objects are read here, tiles are streamed in by tiles() when the level is first
+  // shown and the minimap is drawn by minimapImage() when it is. Files before version 3 have no counts, their tiles are
+  // read once in chunks to count them
+  Level(const std::string& name) : name(name) {
+    File file(path(), "rb");
+    if (!file()) throw std::runtime_error("Can't read level " + path());
+    std::string tilesetName;
+    uint32_t magic = fgetn<uint32_t>(file());
+    if (magic == FILE_MAGIC) {
+      readMetadata(file(), "%16i %32i %32i %s", &version, &width, &height, &tilesetName);
+      if (version > FILE_VERSION) throw std::runtime_error(format("Level %s is version %d, newer than this editor", path().c_str(), version));
+    } else version = 1, width = magic, readMetadata(file(), "%32i %s", &height, &tilesetName);
+    tileset = Textures::atlasByName(tilesetName, "Level " + name);
+    dataOffset = ftell(file());
+    bool read = true;
+    if (version >= 3) {
+      // Written by save() so opening a project reads no tiles
+      uint32_t tiles = fgetn<uint32_t>(file());
+      read = !feof(file());
+      std::pair<uint32_t, uint32_t> chunk[1024];
+      for (size_t left = read ? tiles : 0, n; left; left -= n) {
+        n = min(left, std::size(chunk));
+        if (fread(chunk, sizeof(chunk[0]), n, file()) != n) {
+          read = false;
+          break;
+        }
+        usage.insert(chunk, chunk + n);
+      }
+      usageRevision++;
+      dataOffset = ftell(file());
+      uint32_t bytes = fgetn<uint32_t>(file());
+      read = read && !feof(file());
+      fseek(file(), dataOffset + sizeof(uint32_t) + bytes, SEEK_SET);
+    } else if (version == 1) {
+      vec2i chunk[1024];
+      for (size_t left = width * height, n; left; left -= n) {
+        n = min(left, std::size(chunk));
+        if (fread(chunk, sizeof(vec2i), n, file()) != n) {
+          read = false;
+          break;
+        }
+        count(chunk, n);
+      }
+    } else {
+      uint32_t bytes = fgetn<uint32_t>(file());
+      read = decodeTiles(file(), bytes, width, height, nullptr, [&](const vec2i* row, uint32_t y) { count(row, width); });
+      fseek(file(), dataOffset + sizeof(uint32_t) + bytes, SEEK_SET);  // Objects are still there after corrupt tiles
+    }
+    // The rest of the project loads, this level shows empty and is never saved over its file
+    if (!read) {
+      unreadable = true;
+      usage.clear(), usageRevision++;
+      Textures::reportMissing("Level " + name + ": can't read its tiles from " + path());
+    }
+    uint32_t nObjects = 0;
+    if (read || version > 1) nObjects = version == 1 ? fgetn<uint16_t>(file()) : fgetn<uint32_t>(file());
+    if (feof(file())) nObjects = 0;
+    objects.reserve(nObjects);
+    vector<Textures::Value> values;
+    for (int i = 0; i < nObjects; i++) {
+      vec2i pos;
+      std::string parentName;
+      uint32_t nProperties = 0;
+      readMetadata(file(), version == 1 ? "%32i %32i %s %16i" : "%32i %32i %s %32i", &pos.x, &pos.y, &parentName, &nProperties);
+      auto parent = Textures::objectNames.find(parentName);
+      if (parent) values.resize(parent->properties.size());
+      for (int j = 0; j < nProperties; j++) {
+        std::string property = freadstr(file());
+        if (parent && j < values.size() && !Textures::parseValue(parent->properties[j].type, property, values[j])) {
+          Textures::reportMissing(format("Level %s: %s is not a valid %s for %s.%s", name.c_str(), property.c_str(), Textures::propertyTypes[(int)parent->properties[j].type].c_str(), parentName.c_str(), parent->properties[j].name.c_str()));
+        }
+      }
+      if (!parent) {
+        Textures::reportMissing(format("Level %s: object class %s", name.c_str(), parentName.c_str()));
+        continue;
+      }
+      for (int j = nProperties; j < values.size(); j++) values[j] = parent->properties[j].parsedDefault();
+      objects.emplace_back(parent, pos, values.data());
+    }
+    account();
+  }
+
+  Level(const std::string& name, Textures::Atlas* tileset, uint32_t width, uint32_t height) : tileset(tileset), width(width), height(height), name(name) {
+    data = new vec2i[width * height];
+    std::fill(data, data + width * height, -1);
+    dirty = true;
+    account();
+  }
+
+  ~Level() {
+    if (data) delete[] data;
+    TextureCache::release(&minimap);
+  }
+
+  std::string path() const { return projectSaveDirectory + "levels/" + name + ".lvl"; }
+
+  vec2i* tiles() {
+    if (!data) {
+      data = new vec2i[width * height];
+      File file(path(), "rb");
+      bool read = !unreadable && file() && fseek(file(), dataOffset, SEEK_SET) == 0;
+      if (read && version == 1) read = fread(data, sizeof(vec2i) * width * height, 1, file()) == 1;
+      else if (read) read = decodeTiles(file(), fgetn<uint32_t>(file()), width, height, data);
+      if (!read) {
+        std::fill(data, data + width * height, -1);
+        usage.clear(), usageRevision++;  // Version 3 counts were read without the tiles
+        if (!unreadable) Textures::reportMissing("Level " + name + ": can't read its tiles from " + path());
+        unreadable = true;
+      }
+      account();
+    }
+    touch();
+    return data;
+  }
+
+  bool resident() const override { return data != nullptr; }
+  size_t residentBytes() const override { return sizeof(vec2i) * width * height; }
+  size_t keptBytes() const override { return minimap ? minimap->width * minimap->height * sizeof(MvColor) : 0; }
+  void evict() override {
+    if (unreadable) return;  // Reading again would only fail again
+    delete[] data, data = nullptr, account();
+  }
+
+  void account() {
+    memory.set(Memory::TILES, (data ? residentBytes() : 0) + usage.size() * sizeof(std::pair<const uint32_t, uint32_t>));
+    memory.set(Memory::IMAGES, keptBytes());
+    memory.set(Memory::OBJECTS, objects.capacity() * sizeof(Object));
+  }
+
+  void resize(vec2i size) {
+    if (this->size() == size) return;
+    History::resize(this, size);
+    vec2i* data_ = new vec2i[size.x * size.y];
+    std::fill(data_, data_ + size.x * size.y, -1);
+
+    for (int x = 0; x < min(width, size.x); x++) {
+      for (int y = 0; y < min(height, size.y); y++) {
+        data_[x + (size.y - y - 1) * size.x] = getTile(vec2i(x, height - y - 1));
+      }
+    }
+
+    delete[] data;
+    data = data_;
+    width = size.x, height = size.y;
+    usage.clear(), count(data, width * height);
+    minimap.reset();
+    dirty = true;
+    account();
+    Journal::resize(this);
+  }
+
+  vec2i getTile(vec2i pos) { return tiles()[pos.x + pos.y * width]; }
+  void setTile(vec2i pos, vec2i tile) {
+    vec2i& cell = tiles()[pos.x + pos.y * width];
+    if (cell == tile) return;
+    History::tile(this, pos, cell, tile);
+    uncount(cell);
+    count(&tile, 1);
+    cell = tile;
+    dirty = true;
+    Journal::tile(this, pos, tile);
+    drawMinimap(pos);
+  }
+  vec2i size() { return vec2i(width, height); }
+
+  static uint32_t usageKey(vec2i tile) { return uint16_t(tile.x) | uint32_t(uint16_t(tile.y)) << 16; }
+  uint32_t uses(vec2i tile) const {
+    auto it = usage.find(usageKey(tile));
+    return it == usage.end() ? 0 : it->second;
+  }
+  void count(const vec2i* cells, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+      if (cells[i] != -1) usage[usageKey(cells[i])]++;
+    }
+    usageRevision++;
+  }
+  void uncount(vec2i tile) {
+    auto it = tile == -1 ? usage.end() : usage.find(usageKey(tile));
+    if (it != usage.end() && !--it->second) usage.erase(it);
+    usageRevision++;
+  }
+
+  // Sky where nothing or only transparent pixels are, as render() shows it. Needs the tileset's colors up to date
+  MvColor minimapColor(vec2i tile) const {
+    if (tile == -1 || !inRange(tile.x, 0, tileset->width()) || !inRange(tile.y, 0, tileset->height())) return MvColor(135, 206, 235);
+    MvColor color = tileset->colors[tileset->toIndex(tile)];
+    return color.a ? color : MvColor(135, 206, 235);
+  }
+  uint32_t minimapStep() const { return max(1u, (max(width, height) + MINIMAP_SIZE - 1) / MINIMAP_SIZE); }
+  void startMinimap() {
+    minimap = std::make_unique<MvImage>((vec2i(width, height) + int(minimapStep()) - 1) / int(minimapStep()), nullptr);
+    minimap->clear(MvColor(135, 206, 235));
+    minimapTileset = tileset, minimapTilesetRevision = tileset->revision, minimapRevision++;
+  }
+  MvImage& minimapImage() {
+    if (!minimap || minimapTileset != tileset || minimapTilesetRevision != tileset->revision || tileset->colorsRevision != tileset->revision) {
+      tileset->tileColors();
+      startMinimap();
+      vec2i* tiles = this->tiles();
+      for (int y = 0; y < height; y += minimapStep()) {
+        for (int x = 0; x < width; x += minimapStep()) drawMinimap(vec2i(x, y), tiles[x + y * width]);
+      }
+      account();
+    }
+    return *minimap;
+  }
+  // Cells that aren't the top left one of their minimap pixel don't show
+  void drawMinimap(vec2i pos) {
+    if (!minimap || minimapTileset != tileset || tileset->colorsRevision != tileset->revision || pos.x % minimapStep() || pos.y % minimapStep()) return;
+    drawMinimap(pos, getTile(pos));
+    TextureCache::markDirty(&minimap, pos / int(minimapStep()), 1);
+  }
+  void drawMinimap(vec2i pos, vec2i tile) {
+    if (pos.x % minimapStep() == 0 && pos.y % minimapStep() == 0) minimap->setPixel(pos.x / minimapStep(), pos.y / minimapStep(), minimapColor(tile));
+  }
+
+  void save(vector<Saver::Job>& jobs) {
+    struct Saved {
+      vec2i pos;
+      std::string parent;
+      std::vector<std::string> properties;
+    };
+    vec2i* data = tiles();
+    if (unreadable) return Textures::reportMissing("Level " + name + ": not saved, its tiles couldn't be read");
+    auto tiles = std::make_shared<vector<vec2i>>(data, data + width * height);
+    vector<std::pair<uint32_t, uint32_t>> counts(usage.begin(), usage.end());
+    std::sort(counts.begin(), counts.end());
+    vector<Saved> saved;
+    saved.reserve(objects.size());
+    for (const auto& object : objects) {
+      saved.push_back({object.pos, object.parent->name});
+      for (int i = 0; i < object.parent->properties.size(); i++) saved.back().properties.push_back(Textures::formatValue(object.parent->properties[i].type, object.property(i)));
+    }
+    // Encoded on the saver thread, the copy above is all the UI thread pays for
+    long offset = sizeof(uint32_t) * 4 + sizeof(uint16_t) + tileset->name.size() + 1 + counts.size() * sizeof(counts[0]);
+    jobs.push_back({path(), [width = width, height = height, tilesetName = tileset->name, tiles, counts = std::move(counts), saved = std::move(saved)](const std::string& tmp) {
+      std::string encoded = encodeTiles(tiles->data(), width, height);
+      File file(tmp, "wb+");
+      writeMetadata(file(), "%32i %16i %32i %32i %s %32i", FILE_MAGIC, FILE_VERSION, width, height, tilesetName.c_str(), (int)counts.size());
+      if (!counts.empty()) fwrite((void*)&counts[0], sizeof(counts[0]), counts.size(), file());
+      writeMetadata(file(), "%32i %b %32i", (int)encoded.size(), encoded.data(), (uint32_t)encoded.size(), saved.size());
+      for (const auto& object : saved) {
+        writeMetadata(file(), "%32i %32i %s %32i", object.pos.x, object.pos.y, object.parent.c_str(), object.properties.size());
+        for (const auto& property : object.properties) {
+          fwritestr(file(), property);
+        }
+      }
+    }, [this, offset](bool written) {
+      if (!written) dirty = true;
+      else version = FILE_VERSION, dataOffset = offset;  // Tiles are read back from the new file from now on
+    }});
+    dirty = false;
+  }
+};
+
+extern vector<Level*> levels;
+
+void clear();
+void markDirty(const Textures::Atlas* tileset);
+void markDirty(const Textures::ObjectClass* parent);
+void save(vector<Saver::Job>& jobs);
+void load();
+// Draws the level with its objects as the editor shows it, camera is in screen pixels
+void render(MvImage& viewport, Level* level, vec2f camera, float scale);
+// The piece each quarter of a patch cell is drawn with, two bits per quarter from the top left one, row by row. 0 for
+// cells outside patches, which is also what a patch cell surrounded by its patch gets
+uint8_t quarters(Level* level, vec2i pos);
+// With bakeQuarters every cell is followed by its quarters(), so the device draws patches without reading neighbours.
+// stripUnused numbers tiles as exportedTiles() does, to go with a Textures::exportData that strips them too
+std::string exportData(ExportOrder cells = ExportOrder::ROWS, bool bakeQuarters = false, bool stripUnused = false);
+
+// A level's solid cells merged into few rectangles, in tiles, with a coarse grid listing the rectangles over each of its
+// cells so a collision check only looks at those around the player
+struct Collision {
+  static constexpr int GRID_SHIFT = 3;  // Grid cells are 8x8 tiles
+  struct Rect {
+    uint16_t x, y, width, height;
+  };
+  vector<Rect> rects;
+  vec2i grid = 0;
+  vector<uint16_t> starts, entries;  // Grid cell i has entries[starts[i]] up to entries[starts[i + 1]]
+};
+Collision collision(Level* level);
+std::string exportColliders();
+
+// How many cells of each level drawn with tileset show tile, levels that don't left out
+vector<std::pair<Level*, uint32_t>> usages(const Textures::Atlas* tileset, vec2i tile);
+// Every cell showing from in levels drawn with tileset shows to instead, levels in parallel. Returns the cells changed
+size_t replace(const Textures::Atlas* tileset, vec2i from, vec2i to);
+// Every cell in the rectangle shows tile, as one undo step. Returns the cells changed
+size_t fill(Level* level, vec2i pos, vec2i size, vec2i tile);
+// Whether some level drawn with the atlas shows each of its tiles, by index. Kept until those levels' counts change
+const vector<uint8_t>& usedTiles(const Textures::Atlas* atlas);
+// Index of each of the atlas's tiles in an export that strips the ones no level uses, -1 if stripped. Patches stay whole
+// and tile 0 stays for object classes drawn with it. Atlases no level uses as tileset are kept as they are
+vector<int> exportedTiles(const Textures::Atlas* atlas);
+}  // namespace TiledLevel
+
+namespace Project {
+extern std::atomic<int> loaded, toLoad;
+
+// Everything in projectSaveDirectory, throws if a file can't be read. Broken references are left in Textures::takeMissing
+void load();
+// Everything as one C++ header of typed PROGMEM tables, an alternative to the two flat byte streams
+std::string exportHeader();
+}  // namespace Project
@@ -0,0 +1,56 @@
+#include "cache.hpp"
+#include "profiler.hpp"
+#include <mutex>
+
+namespace Cache {
+size_t budget = 512 * 1024 * 1024;
+uint64_t frame = 0;
+static vector<Asset*> assets;
+static std::mutex mutex;  // Assets are constructed from the loader's worker threads
+
+Asset::Asset() {
+  std::lock_guard<std::mutex> lock(mutex);
+  assets.push_back(this);
+}
+
+Asset::~Asset() {
+  std::lock_guard<std::mutex> lock(mutex);
+  assets.erase(std::remove(assets.begin(), assets.end(), this), assets.end());
+}
+
+void Asset::touch() { lastUse = frame; }
+
+size_t residentBytes() {
+  std::lock_guard<std::mutex> lock(mutex);
+  size_t total = 0;
+  for (const auto asset : assets) {
+    total += asset->keptBytes();
+    if (asset->resident()) total += asset->residentBytes();
+  }
+  return total;
+}
+
+void trim() {
+  PROFILE("Cache::trim");
+  size_t total = residentBytes();
+  if (total <= budget) return;
+
+  // Least recently used first. Dirty assets can't be dropped, and anything used last frame would be loaded right back
+  std::lock_guard<std::mutex> lock(mutex);
+  vector<Asset*> candidates;
+  for (const auto asset : assets) {
+    if (asset->resident() && !asset->dirty && asset->lastUse + 1 < frame) candidates.push_back(asset);
+  }
+  std::sort(candidates.begin(), candidates.end(), [](Asset* a, Asset* b) { return a->lastUse < b->lastUse; });
+  for (const auto asset : candidates) {
+    if (total <= budget) break;
+    total -= asset->residentBytes();
+    asset->evict();
+  }
+}
+
+void nextFrame(bool canTrim) {
+  if (canTrim) trim();
+  frame++;
+}
+}  // namespace Cache
@@ -0,0 +1,25 @@
+#pragma once
+#include "base.hpp"
+
+namespace Cache {
+// Anything whose heavy part (pixels, tiles) can be dropped and read back from disk on demand
+struct Asset {
+  bool dirty = false;
+  uint64_t lastUse = 0;
+
+  Asset();
+  virtual ~Asset();
+  virtual bool resident() const = 0;
+  virtual size_t residentBytes() const = 0;
+  virtual size_t keptBytes() const { return 0; }  // Held even while evicted, still counted against the budget
+  virtual void evict() = 0;
+  void touch();
+};
+
+extern size_t budget;
+extern uint64_t frame;
+
+size_t residentBytes();
+void trim();
+void nextFrame(bool canTrim = true);
+}  // namespace Cache
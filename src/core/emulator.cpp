@@ -0,0 +1,181 @@
+#include "emulator.hpp"
+
+namespace Emulator {
+static constexpr uint16_t TRANSPARENT = 0xf81f;
+
+vector<uint8_t> parse(const std::string& source) {
+  size_t start = source.find('{'), end = source.find('}', start);
+  if (start == std::string::npos || end == std::string::npos) throw std::runtime_error("No array in export");
+  vector<uint8_t> bytes;
+  const char* c = source.c_str() + start + 1;
+  while (c < source.c_str() + end) {
+    char* next;
+    long value = strtol(c, &next, 0);
+    if (next == c) c++;
+    else bytes.push_back(value), c = next;
+  }
+  return bytes;
+}
+
+ExportOrder layout(const std::string& source, const std::string& define) {
+  size_t at = source.find("#define " + define + " ");
+  if (at == std::string::npos) return ExportOrder::ROWS;
+  int value = atoi(source.c_str() + at + define.size() + 9);
+  if (value < 0 || value > (int)ExportOrder::COLUMNS) throw std::runtime_error(format("Unknown %s %d", define.c_str(), value));
+  return ExportOrder(value);
+}
+
+vector<vector<Textures::PropertyType>> schemas() {
+  vector<vector<Textures::PropertyType>> schemas;
+  for (const auto object : Textures::objects) {
+    schemas.emplace_back();
+    for (const auto& property : object->properties) schemas.back().push_back(property.type);
+  }
+  return schemas;
+}
+
+// Little endian like itobytes, pixels are the one big endian field and swap themselves
+uint32_t Device::fetch(const vector<uint8_t>& flash, size_t at, int bytes, uint64_t& counter) {
+  if (at + bytes > flash.size()) throw std::runtime_error(format("Export ends at %d, read at %d", (int)flash.size(), (int)at));
+  uint32_t value = 0;
+  for (int i = 0; i < bytes; i++) value |= flash[at + i] << (i * 8);
+  counter += bytes;
+  if (&flash[at] != next) fetched.bursts++;
+  next = &flash[at] + bytes;
+  return value;
+}
+
+// Walks the atlases before it, patch lists are only read for the one asked for
+Device::Atlas Device::atlas(int index) {
+  int count = fetch(textures, 0, 2, fetched.index);
+  if (index < 0 || index >= count) throw std::runtime_error(format("No atlas %d, the export has %d", index, count));
+  size_t at = 2;
+  for (int i = 0;; i++) {
+    Atlas atlas;
+    atlas.tiles = fetch(textures, at, 1, fetched.index);
+    atlas.tilesize = vec2i(fetch(textures, at + 1, 1, fetched.index), fetch(textures, at + 2, 1, fetched.index));
+    atlas.pixels = at + 3;
+    at = atlas.pixels + atlas.tiles * atlas.tilesize.x * atlas.tilesize.y * 2;
+    if (fetch(textures, at++, 1, fetched.index)) {
+      int patches = fetch(textures, at++, 1, fetched.index);
+      if (i == index && !quarters) {
+        for (int j = 0; j < patches; j++) atlas.patches.push_back(fetch(textures, at + j, 1, fetched.index) - 1);
+      }
+      at += patches;
+      if (fetch(textures, at++, 1, fetched.index)) at += (atlas.tiles + 7) / 8;
+    }
+    if (i + 1 == count) classTable = at;
+    if (i == index) return atlas;
+  }
+}
+
+// Calls visit for every cell of [start, end), row by row or column by column, the way the device would walk that layout
+template <typename F> static void walk(ExportOrder order, vec2i start, vec2i end, F visit) {
+  bool columns = order == ExportOrder::COLUMNS;
+  for (int i = columns ? start.x : start.y; i < (columns ? end.x : end.y); i++) {
+    for (int j = columns ? start.y : start.x; j < (columns ? end.y : end.x); j++) visit(columns ? vec2i(i, j) : vec2i(j, i));
+  }
+}
+
+// Transparent pixels are read too, the device can't know before it has them
+void Device::blit(const Atlas& atlas, int tile, vec2i source, vec2i size, vec2i screen) {
+  if (tile < 0 || tile >= atlas.tiles) return;
+  walk(pixels, max(screen, vec2i(0)), min(screen + size, vec2i(SIZE)), [&](vec2i at) {
+    vec2i pixel = source + at - screen;
+    int offset = pixels == ExportOrder::ROWS ? pixel.x + pixel.y * atlas.tilesize.x : pixel.y + pixel.x * atlas.tilesize.y;
+    uint16_t color = fetch(textures, atlas.pixels + (tile * atlas.tilesize.x * atlas.tilesize.y + offset) * 2, 2, fetched.pixels);
+    color = color >> 8 | color << 8;
+    if (color != TRANSPARENT) framebuffer[at.x + at.y * SIZE] = color;
+  });
+}
+
+void Device::render(int level, int tileset, vec2i camera) {
+  fetched = Fetched(), next = nullptr;
+  size_t at = 0;
+  int count = fetch(levels, at, 2, fetched.index);
+  if (level < 0 || level >= count) throw std::runtime_error(format("No level %d, the export has %d", level, count));
+  at += 2;
+  int cellBytes = quarters ? 2 : 1;
+  for (int i = 0; i < level; i++) {
+    at += 4 + fetch(levels, at, 2, fetched.index) * fetch(levels, at + 2, 2, fetched.index) * cellBytes;
+    at += 4 + fetch(levels, at, 4, fetched.index);
+  }
+  vec2i size(fetch(levels, at, 2, fetched.index), fetch(levels, at + 2, 2, fetched.index));
+  size_t firstCell = at + 4, objects = firstCell + size.x * size.y * cellBytes + 4;
+  Atlas atlas = this->atlas(tileset);
+
+  // Sky over the level, black around it, as the editor draws it
+  uint16_t sky = rgb565(MvColor(135, 206, 235));
+  for (int y = 0; y < SIZE; y++) {
+    for (int x = 0; x < SIZE; x++) framebuffer[x + y * SIZE] = inRange(x + camera.x, 0, size.x * atlas.tilesize.x) && inRange(y + camera.y, 0, size.y * atlas.tilesize.y) ? sky : 0;
+  }
+
+  auto cellAt = [&](vec2i pos) { return firstCell + (cells == ExportOrder::ROWS ? pos.x + pos.y * size.x : pos.y + pos.x * size.y) * cellBytes; };
+  auto cell = [&](vec2i pos) -> int {
+    if (!inRange(pos.x, 0, size.x) || !inRange(pos.y, 0, size.y)) return -1;
+    return fetch(levels, cellAt(pos), 1, fetched.tiles);
+  };
+  vec2i first = max(camera / atlas.tilesize, vec2i(0)), last = min((camera + SIZE - 1) / atlas.tilesize, size - 1);
+  walk(cells, first, last + 1, [&](vec2i pos) {
+    int value = cell(pos);
+    if (!value) return;
+    int tile = value - 1, patch = -1;
+    vec2i screen = pos * atlas.tilesize - camera, half = atlas.tilesize / 2;
+
+    // The piece of each quarter is right after the cell, the patch lists aren't needed
+    if (quarters) {
+      int pieces = fetch(levels, cellAt(pos) + 1, 1, fetched.tiles);
+      if (!pieces) return blit(atlas, tile, 0, atlas.tilesize, screen);
+      for (int quarter = 0; quarter < 4; quarter++) {
+        vec2i q(quarter % 2, quarter / 2);
+        blit(atlas, tile + (pieces >> (quarter * 2) & 3), q * half, half, screen + q * half);
+      }
+      return;
+    }
+
+    for (int start : atlas.patches) {
+      if (tile >= start && tile < start + 4) patch = start;
+    }
+    if (patch == -1) return blit(atlas, tile, 0, atlas.tilesize, screen);
+
+    // Same quarter picking as TiledLevel::render: edge, corner or inner piece by which neighbours continue the patch
+    for (int quarter = 0; quarter < 4; quarter++) {
+      vec2i q(quarter % 2, quarter / 2), delta = q * 2 - 1;
+      bool alongX = cell(pos + vec2i(delta.x, 0)) == patch + 1, alongY = cell(pos + vec2i(0, delta.y)) == patch + 1;
+      int piece = !alongX ? (alongY ? 3 : 1) : !alongY ? 2 : 0;
+      blit(atlas, patch + piece, q * half, half, screen + q * half);
+    }
+  });
+
+  // Objects are drawn with the first tile of their class's atlas. Atlases are looked up once a frame
+  if (schemas.empty()) return;
+  std::map<int, Atlas> sprites;
+  if (!classTable) this->atlas(fetch(textures, 0, 2, fetched.index) - 1);
+  int instances = fetch(levels, objects, 2, fetched.objects);
+  at = objects + 2;
+  for (int i = 0; i < instances; i++) {
+    vec2i pos(fetch(levels, at, 2, fetched.objects), fetch(levels, at + 2, 2, fetched.objects));
+    int parent = fetch(levels, at + 4, 2, fetched.objects);
+    at += 6;
+    if (parent >= schemas.size()) throw std::runtime_error(format("Object class %d has no schema", parent));
+    for (auto type : schemas[parent]) {
+      if (type == Textures::PropertyType::INT) at += 4;
+      else if (type == Textures::PropertyType::STRING) {
+        while (fetch(levels, at++, 1, fetched.objects)) {}
+      }
+    }
+
+    int sprite = fetch(textures, classTable + 2 + parent * 2, 2, fetched.objects);
+    if (!sprites.count(sprite)) sprites[sprite] = this->atlas(sprite);
+    blit(sprites[sprite], 0, 0, sprites[sprite].tilesize, pos - camera);
+  }
+}
+
+MvImage Device::image() const {
+  MvImage image(vec2i(SIZE), nullptr);
+  for (int y = 0; y < SIZE; y++) {
+    for (int x = 0; x < SIZE; x++) image.setPixel(x, y, rgb565(framebuffer[x + y * SIZE]));
+  }
+  return image;
+}
+}  // namespace Emulator
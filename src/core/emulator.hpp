@@ -0,0 +1,61 @@
+#pragma once
+#include "assets.hpp"
+#include <map>
+
+// Renders levels from the flat Textures::exportData / TiledLevel::exportData arrays the way the SSD1351 firmware reads
+// them, into a 128x128 RGB565 framebuffer. Every byte taken from the arrays is counted, as the device would fetch it
+// from PROGMEM
+namespace Emulator {
+constexpr int SIZE = 128;
+
+// Bytes read during the last frame, by what they were read for
+struct Fetched {
+  uint64_t index = 0;    // Walking the arrays to find the atlas and level, atlas headers and patch lists
+  uint64_t tiles = 0;    // Level cells, neighbours or baked quarters included
+  uint64_t pixels = 0;   // Tile pixels
+  uint64_t objects = 0;  // Instance records and their class's atlas
+  uint64_t bursts = 0;   // Contiguous runs the reads came in, each costs the device a new address
+
+  uint64_t total() const { return index + tiles + pixels + objects; }
+};
+
+// Bytes of a `const uint8_t PROGMEM name[] = {...};` export, throws if there's none
+vector<uint8_t> parse(const std::string& source);
+// What the export's ORE_*_LAYOUT define says, ROWS without one
+ExportOrder layout(const std::string& source, const std::string& define);
+
+// The property types of every object class, needed to step over instance records since their size isn't exported
+vector<vector<Textures::PropertyType>> schemas();
+
+struct Device {
+  vector<uint8_t> textures, levels;
+  vector<vector<Textures::PropertyType>> schemas;  // Objects aren't drawn without them
+  uint16_t framebuffer[SIZE * SIZE];
+  Fetched fetched;
+  size_t classTable = 0;  // Where the atlas index of each object class is, after the atlases
+  ExportOrder pixels, cells;
+  bool quarters;  // Cells come with their baked quarters, patches need no neighbours
+  const uint8_t* next = nullptr;  // Right after the last byte read, a read anywhere else starts a burst
+
+  Device(const std::string& texturesSource, const std::string& levelsSource, vector<vector<Textures::PropertyType>> schemas = {}) : textures(parse(texturesSource)), levels(parse(levelsSource)), schemas(std::move(schemas)) {
+    pixels = layout(texturesSource, "ORE_TEXTURES_LAYOUT"), cells = layout(levelsSource, "ORE_LEVELS_LAYOUT");
+    quarters = levelsSource.find("#define ORE_LEVELS_QUARTERS 1") != std::string::npos;
+  }
+
+  // The level with its top left corner at -camera, tiles from the given atlas since levels don't export their tileset.
+  // Throws if either doesn't exist or the arrays end early
+  void render(int level, int tileset, vec2i camera);
+  MvImage image() const;
+
+  struct Atlas {
+    size_t pixels;
+    int tiles;
+    vec2i tilesize;
+    vector<int> patches;  // First tile of each
+  };
+
+  uint32_t fetch(const vector<uint8_t>& flash, size_t at, int bytes, uint64_t& counter);
+  Atlas atlas(int index);
+  void blit(const Atlas& atlas, int tile, vec2i source, vec2i size, vec2i screen);
+};
+}  // namespace Emulator
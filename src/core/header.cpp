@@ -0,0 +1,211 @@
+#include "assets.hpp"
+#include <set>
+#include <map>
+#include <cmath>
+
+// The structured export: typed descriptors and instance tables instead of one byte stream, so firmware indexes assets
+// directly and the compiler checks property access
+namespace Project {
+static const std::set<std::string> keywords = {"alignas", "alignof", "and", "asm", "auto", "bool", "break", "case", "catch", "char", "class", "const", "constexpr", "continue", "default", "delete", "do", "double", "else", "enum", "explicit", "export", "extern", "false", "float", "for", "friend", "goto", "if", "inline", "int", "long", "mutable", "namespace", "new", "noexcept", "not", "nullptr", "operator", "or", "private", "protected", "public", "register", "return", "short", "signed", "sizeof", "static", "struct", "switch", "template", "this", "throw", "true", "try", "typedef", "typename", "union", "unsigned", "using", "virtual", "void", "volatile", "while", "xor"};
+
+// A C++ identifier for name that isn't in used yet
+static std::string identifier(const std::string& name, std::set<std::string>& used) {
+  std::string id;
+  for (char c : name) id += isalnum((uint8_t)c) ? c : '_';
+  if (id.empty() || isdigit((uint8_t)id[0])) id = "_" + id;
+  if (keywords.count(id)) id += '_';
+  std::string unique = id;
+  for (int i = 2; !used.insert(unique).second; i++) unique = format("%s_%d", id.c_str(), i);
+  return unique;
+}
+
+static std::string quote(const std::string& text) {
+  std::string out = "\"";
+  for (uint8_t c : text) {
+    if (c == '"' || c == '\\') out += '\\', out += c;
+    else if (c < 32 || c > 126) out += format("\\%03o", c);  // Octal takes at most three digits, hex would run on
+    else out += c;
+  }
+  return out + "\"";
+}
+
+static std::string floatLiteral(float value) {
+  std::string text = format("%.9g", std::isfinite(value) ? value : 0.f);
+  if (text.find_first_of(".e") == std::string::npos) text += ".0";
+  return text + "f";
+}
+
+// Arrays can't be empty, a table with nothing in it gets one zeroed entry
+static std::string size(size_t count) { return count ? "[]" : "[1]"; }
+
+// Numbers are written sixteen to a line
+static void list(std::string& out, size_t count, const std::function<std::string(size_t)>& item) {
+  for (size_t i = 0; i < count; i++) out += (i % 16 ? " " : "\n  ") + item(i) + ",";
+  out += "\n};\n";
+}
+
+std::string exportHeader() {
+  std::string out = "// Generated by Ore Asset Editor. Tables live in PROGMEM, read them with Ore::read(). Include from one source file\n";
+  out += "#pragma once\n#include <stdint.h>\n#include <string.h>\n";
+  out += "#if defined(__AVR__)\n#include <avr/pgmspace.h>\n#define ORE_MEMCPY memcpy_P\n#else\n#ifndef PROGMEM\n#define PROGMEM\n#endif\n#define ORE_MEMCPY memcpy\n#endif\n\n";
+  out += "namespace Ore {\n";
+  out += "template <class T> inline T read(const T* item) {\n  T value;\n  ORE_MEMCPY(&value, item, sizeof(T));\n  return value;\n}\n\n";
+  out += "struct Atlas {\n  uint16_t tiles, width, height;  // width and height in tiles\n  uint8_t tileWidth, tileHeight;\n";
+  out += "  const uint16_t* pixels;  // RGB565 tile after tile, each one row by row, 0xf81f is transparent\n";
+  out += "  bool tileset;\n  uint16_t patchCount;\n  const uint16_t* patches;  // First tile of each four tile patch\n";
+  out += "  const uint8_t* colliders;  // One bit per tile, lowest first, nullptr without colliders\n};\n\n";
+  out += "struct ObjectClass {\n  uint16_t atlas;\n  uint16_t size;  // Of its instance struct in Ore::Objects\n};\n\n";
+  out += "struct Instances {\n  uint16_t objectClass, count;\n  const void* items;\n};\n\n";
+  out += "struct Rect {\n  uint16_t x, y, width, height;  // In tiles\n};\n\n";
+  out += "struct Level {\n  uint16_t width, height, tileset;\n  uint8_t tileBytes;  // 1 or 2\n";
+  out += "  const void* tiles;  // Row by row, tile index + 1 or 0 for none, uint8_t or uint16_t by tileBytes\n";
+  out += "  uint16_t objects, instanceTables;\n  const Instances* instances;  // One per object class placed, by class id\n";
+  out += "  uint16_t rects;\n  const Rect* colliders;  // Solid cells merged into rectangles\n";
+  out += format("  uint16_t gridWidth, gridHeight;  // Grid cells are %d tiles square\n", 1 << TiledLevel::Collision::GRID_SHIFT);
+  out += "  const uint16_t* gridStarts;  // Grid cell i lists gridRects[gridStarts[i]] up to gridRects[gridStarts[i + 1]]\n  const uint16_t* gridRects;\n};\n\n";
+
+  std::set<std::string> atlasIds = {"COUNT"}, classIds = {"COUNT"}, levelIds = {"COUNT"};
+  vector<std::string> atlasNames, classNames, levelNames;
+  for (const auto atlas : Textures::atlases) atlasNames.push_back(identifier(atlas->name, atlasIds));
+  for (const auto object : Textures::objects) classNames.push_back(identifier(object->name, classIds));
+  for (const auto level : TiledLevel::levels) levelNames.push_back(identifier(level->name, levelIds));
+  for (const auto& [type, names] : {std::make_pair("AtlasId", &atlasNames), std::make_pair("ObjectClassId", &classNames), std::make_pair("LevelId", &levelNames)}) {
+    out += format("enum class %s : uint16_t {", type);
+    for (const auto& name : *names) out += " " + name + ",";
+    out += " COUNT };\n";
+  }
+
+  // Packed sprites by name, the tile is an index into their atlas
+  out += "\nstruct Sprite {\n  AtlasId atlas;\n  uint16_t tile;\n  uint8_t width, height;  // In tiles\n  int16_t offsetX, offsetY;  // Where the trimmed pixels were in the source image\n};\n\nnamespace Sprites {\n";
+  std::set<std::string> spriteIds;
+  for (int i = 0; i < Textures::atlases.size(); i++) {
+    for (const auto& sprite : Textures::atlases[i]->sprites) {
+      out += format("constexpr Sprite %s = {AtlasId::%s, %d, %d, %d, %d, %d};\n", identifier(sprite.name, spriteIds).c_str(), atlasNames[i].c_str(), Textures::atlases[i]->toIndex(sprite.tile), sprite.tiles.x, sprite.tiles.y, sprite.offset.x, sprite.offset.y);
+    }
+  }
+  out += "}  // namespace Sprites\n";
+
+  // One struct per class with a field per property, in property order
+  out += "\nnamespace Objects {\n";
+  for (int i = 0; i < Textures::objects.size(); i++) {
+    const auto object = Textures::objects[i];
+    out += format("struct %s {\n  static constexpr ObjectClassId id = ObjectClassId::%s;\n  uint16_t x, y;\n", classNames[i].c_str(), classNames[i].c_str());
+    std::set<std::string> fields = {"id", "x", "y"};
+    for (const auto& property : object->properties) {
+      const char* type = property.type == Textures::PropertyType::INT ? "int32_t" : property.type == Textures::PropertyType::FLOAT ? "float" : "const char*";
+      out += format("  %s %s;\n", type, identifier(property.name, fields).c_str());
+    }
+    out += "};\n";
+  }
+  out += "}  // namespace Objects\n\nnamespace Data {\n";
+
+  for (int i = 0; i < Textures::atlases.size(); i++) {
+    const auto atlas = Textures::atlases[i];
+    MvImage& image = atlas->image();
+    int tiles = atlas->width() * atlas->height(), tilePixels = atlas->tilesize.x * atlas->tilesize.y;
+    if (!tiles) continue;
+    out += format("const uint16_t %s_pixels[] PROGMEM = {", atlasNames[i].c_str());
+    list(out, (size_t)tiles * tilePixels, [&](size_t n) {
+      int tile = n / tilePixels, pixel = n % tilePixels;
+      vec2i pos = vec2i(tile % atlas->width(), tile / atlas->width()) * atlas->tilesize + vec2i(pixel % atlas->tilesize.x, pixel / atlas->tilesize.x);
+      return format("0x%04x", rgb565(image.getPixel(pos.x, pos.y)));
+    });
+    if (atlas->tileset && !atlas->tileset->patches.empty()) {
+      out += format("const uint16_t %s_patches[] PROGMEM = {", atlasNames[i].c_str());
+      list(out, atlas->tileset->patches.size(), [&](size_t n) { return format("%d", atlas->toIndex(atlas->tileset->patches[n])); });
+    }
+    if (atlas->tileset && atlas->tileset->colliders) {
+      out += format("const uint8_t %s_colliders[] PROGMEM = {", atlasNames[i].c_str());
+      list(out, (tiles + 7) / 8, [&](size_t n) {
+        uint8_t byte = 0;
+        for (int j = 0; j < 8 && n * 8 + j < tiles; j++) byte |= atlas->tileset->colliders[n * 8 + j] << j;
+        return format("0x%02x", byte);
+      });
+    }
+  }
+
+  // Instance tables are written first so the strings they use are known, strings must come before them
+  std::string instances;
+  std::set<uint32_t> strings;
+  vector<TiledLevel::Collision> collisions;
+  for (int i = 0; i < TiledLevel::levels.size(); i++) {
+    const auto level = TiledLevel::levels[i];
+    int tileBytes = level->tileset->width() * level->tileset->height() < 255 ? 1 : 2;
+    out += format("const uint%d_t %s_tiles[] PROGMEM = {", tileBytes * 8, levelNames[i].c_str());
+    vec2i* tiles = level->tiles();
+    list(out, level->width * level->height, [&](size_t n) { return format("%d", tiles[n] == -1 ? 0 : level->tileset->toIndex(tiles[n]) + 1); });
+
+    collisions.push_back(TiledLevel::collision(level));
+    const auto& collision = collisions.back();
+    if (collision.rects.size() > UINT16_MAX || collision.entries.size() > UINT16_MAX) throw std::runtime_error("Level " + level->name + " has too many collision rectangles to export");
+    if (!collision.rects.empty()) {
+      out += format("const Rect %s_colliders[] PROGMEM = {\n", levelNames[i].c_str());
+      for (const auto& rect : collision.rects) out += format("  {%d, %d, %d, %d},\n", rect.x, rect.y, rect.width, rect.height);
+      out += format("};\nconst uint16_t %s_gridStarts[] PROGMEM = {", levelNames[i].c_str());
+      list(out, collision.starts.size(), [&](size_t n) { return format("%d", collision.starts[n]); });
+      out += format("const uint16_t %s_gridRects[] PROGMEM = {", levelNames[i].c_str());
+      list(out, collision.entries.size(), [&](size_t n) { return format("%d", collision.entries[n]); });
+    }
+
+    std::map<uint32_t, vector<const TiledLevel::Object*>> byClass;
+    for (const auto& object : level->objects) byClass[object.parent->index].push_back(&object);
+    for (const auto& [index, placed] : byClass) {
+      const auto object = Textures::objects[index];
+      instances += format("const Objects::%s %s_%s[] PROGMEM = {\n", classNames[index].c_str(), levelNames[i].c_str(), classNames[index].c_str());
+      for (const auto instance : placed) {
+        vec2i pos = max(min(instance->pos, vec2i(UINT16_MAX)), vec2i(0));
+        instances += format("  {%d, %d", pos.x, pos.y);
+        for (int j = 0; j < object->properties.size(); j++) {
+          Textures::Value value = instance->property(j);
+          if (object->properties[j].type == Textures::PropertyType::INT) instances += format(", %d", value.i);
+          else if (object->properties[j].type == Textures::PropertyType::FLOAT) instances += ", " + floatLiteral(value.f);
+          else instances += format(", string_%u", value.s), strings.insert(value.s);
+        }
+        instances += "},\n";
+      }
+      instances += "};\n";
+    }
+    if (!byClass.empty()) {
+      instances += format("const Instances %s_instances[] PROGMEM = {\n", levelNames[i].c_str());
+      for (const auto& [index, placed] : byClass) instances += format("  {uint16_t(ObjectClassId::%s), %d, %s_%s},\n", classNames[index].c_str(), (int)placed.size(), levelNames[i].c_str(), classNames[index].c_str());
+      instances += "};\n";
+    }
+  }
+  for (uint32_t id : strings) out += format("const char string_%u[] PROGMEM = %s;\n", id, quote(Strings::get(id)).c_str());
+  out += instances + "}  // namespace Data\n\n";
+
+  out += format("const Atlas atlases%s PROGMEM = {\n", size(Textures::atlases.size()).c_str());
+  for (int i = 0; i < Textures::atlases.size(); i++) {
+    const auto atlas = Textures::atlases[i];
+    const char* name = atlasNames[i].c_str();
+    bool patches = atlas->tileset && !atlas->tileset->patches.empty(), colliders = atlas->tileset && atlas->tileset->colliders;
+    out += format("  {%d, %d, %d, %d, %d, %s, %s, %d, ", atlas->width() * atlas->height(), atlas->width(), atlas->height(), atlas->tilesize.x, atlas->tilesize.y, atlas->width() * atlas->height() ? format("Data::%s_pixels", name).c_str() : "nullptr", atlas->tileset ? "true" : "false", patches ? (int)atlas->tileset->patches.size() : 0);
+    out += (patches ? format("Data::%s_patches, ", name) : std::string("nullptr, ")) + (colliders ? format("Data::%s_colliders},\n", name) : std::string("nullptr},\n"));
+  }
+  out += format("};\n\nconst ObjectClass objectClasses%s PROGMEM = {\n", size(Textures::objects.size()).c_str());
+  for (int i = 0; i < Textures::objects.size(); i++) out += format("  {%d, sizeof(Objects::%s)},\n", Textures::objects[i]->atlas->index, classNames[i].c_str());
+  out += format("};\n\nconst Level levels%s PROGMEM = {\n", size(TiledLevel::levels.size()).c_str());
+  for (int i = 0; i < TiledLevel::levels.size(); i++) {
+    const auto level = TiledLevel::levels[i];
+    std::set<uint32_t> classes;
+    for (const auto& object : level->objects) classes.insert(object.parent->index);
+    int tileBytes = level->tileset->width() * level->tileset->height() < 255 ? 1 : 2;
+    out += format("  {%d, %d, %d, %d, Data::%s_tiles, %d, %d, ", level->width, level->height, level->tileset->index, tileBytes, levelNames[i].c_str(), (int)level->objects.size(), (int)classes.size());
+    out += classes.empty() ? std::string("nullptr, ") : format("Data::%s_instances, ", levelNames[i].c_str());
+    const auto& collision = collisions[i];
+    if (collision.rects.empty()) out += format("0, nullptr, %d, %d, nullptr, nullptr},\n", collision.grid.x, collision.grid.y);
+    else out += format("%d, Data::%s_colliders, %d, %d, Data::%s_gridStarts, Data::%s_gridRects},\n", (int)collision.rects.size(), levelNames[i].c_str(), collision.grid.x, collision.grid.y, levelNames[i].c_str(), levelNames[i].c_str());
+  }
+  out += "};\n\n";
+
+  out += "inline Atlas atlas(AtlasId id) { return read(&atlases[uint16_t(id)]); }\n";
+  out += "inline ObjectClass objectClass(ObjectClassId id) { return read(&objectClasses[uint16_t(id)]); }\n";
+  out += "inline Level level(LevelId id) { return read(&levels[uint16_t(id)]); }\n\n";
+  out += "// The level's instances of an Ore::Objects type, read each with read(). nullptr and count 0 if there are none\n";
+  out += "template <class T> inline const T* instances(const Level& level, uint16_t& count) {\n";
+  out += "  for (uint16_t i = 0; i < level.instanceTables; i++) {\n    Instances table = read(&level.instances[i]);\n";
+  out += "    if (table.objectClass == uint16_t(T::id)) return count = table.count, (const T*)table.items;\n  }\n";
+  out += "  return count = 0, nullptr;\n}\n}  // namespace Ore\n";
+  return out;
+}
+}  // namespace Project
@@ -0,0 +1,337 @@
+#include "assets.hpp"
+#include <deque>
+
+namespace History {
+enum Op : uint8_t { TILES, RESIZE, OBJECT_ADD, OBJECT_REMOVE, OBJECT_MOVE, PROPERTY, PATCH, COLLIDER, TILESET, LEVEL_TILESET };
+
+// Edits that swap a value keep the one to swap back to, so the same code undoes and redoes them
+struct Edit {
+  Op op;
+  TiledLevel::Level* level = nullptr;
+  Textures::Atlas* atlas = nullptr;  // Or LEVEL_TILESET's other tileset
+  int index = 0, property = 0;
+  vec2i from = 0, to = 0;  // RESIZE sizes, the object's position or the patch
+  bool on = false;         // Patch added, collider solid
+  Cells cells;             // TILES, and the cells RESIZE cropped
+  Textures::ObjectClass* parent = nullptr;
+  vector<Textures::Value> values;  // The object's properties, or PROPERTY's other value
+  bool hasTileset = false, hasColliders = false;
+  vector<vec2i> patches;
+  vector<bool> colliders;
+
+  Edit(Op op) : op(op) {}
+  size_t bytes() const { return sizeof(Edit) + cells.bytes() + values.capacity() * sizeof(Textures::Value) + patches.capacity() * sizeof(vec2i) + colliders.capacity() / 8; }
+};
+
+struct Step {
+  vector<Edit> edits;
+  size_t bytes = 0;
+
+  void measure() {
+    bytes = sizeof(Step);
+    for (const auto& edit : edits) bytes += edit.bytes();
+  }
+};
+
+size_t budget = size_t(64) << 20;
+Memory::Account memory;
+static std::deque<Step> done, undone;
+static Step open;
+static int depth = 0;
+static bool applying = false;  // Undoing or redoing, which goes through the same calls that record edits
+static size_t bytes = 0;       // Of done and undone
+
+static void commit() {
+  if (open.edits.empty()) return;
+  for (const auto& step : undone) bytes -= step.bytes;
+  undone.clear();
+  open.measure();
+  bytes += open.bytes;
+  done.push_back(std::move(open));
+  open = Step();
+  while (bytes > budget && done.size() > 1) bytes -= done.front().bytes, done.pop_front();
+  memory.set(Memory::HISTORY, bytes);
+}
+
+static void record(Edit&& edit) {
+  open.edits.push_back(std::move(edit));
+  if (!depth) commit();
+}
+
+void begin() { depth++; }
+
+void end() {
+  if (depth && !--depth) commit();
+}
+
+void clear() {
+  done.clear(), undone.clear(), open = Step();
+  bytes = 0;
+  memory.set(Memory::HISTORY, 0);
+}
+
+bool canUndo() { return !done.empty() || !open.edits.empty(); }
+bool canRedo() { return !undone.empty() && open.edits.empty(); }
+
+void apply(TiledLevel::Level* level, const Cells& cells, bool redo) {
+  PROFILE("History::apply");
+  const vector<Cells::Run>& to = redo ? cells.after : cells.before;
+  const vector<Cells::Run>& from = redo ? cells.before : cells.after;
+  // Counts go by run. Added first, a tile a cell only had halfway through the step never drops below zero
+  for (const auto& run : to) {
+    if (run.tile != -1) level->usage[TiledLevel::Level::usageKey(run.tile)] += run.count;
+  }
+  for (const auto& run : from) {
+    auto it = run.tile == -1 ? level->usage.end() : level->usage.find(TiledLevel::Level::usageKey(run.tile));
+    if (it != level->usage.end() && !(it->second -= min(it->second, run.count))) level->usage.erase(it);
+  }
+  level->usageRevision++;
+
+  // Undone backwards, so a cell changed twice in the step gets what it had first
+  vec2i* tiles = level->tiles();
+  if (redo) {
+    size_t run = 0;
+    uint32_t left = to.empty() ? 0 : to[0].count;
+    for (const auto& span : cells.spans) {
+      for (uint32_t i = 0; i < span.count;) {
+        while (!left) left = to[++run].count;
+        uint32_t n = min(left, span.count - i);
+        std::fill(tiles + span.start + i, tiles + span.start + i + n, to[run].tile);
+        Journal::tiles(level, span.start + i, n, to[run].tile);
+        i += n, left -= n;
+      }
+    }
+  } else {
+    size_t run = to.size();
+    uint32_t left = 0;
+    for (size_t s = cells.spans.size(); s-- > 0;) {
+      const auto& span = cells.spans[s];
+      for (uint32_t i = span.count; i > 0;) {
+        while (!left) left = to[--run].count;
+        uint32_t n = min(left, i);
+        i -= n, left -= n;
+        std::fill(tiles + span.start + i, tiles + span.start + i + n, to[run].tile);
+        Journal::tiles(level, span.start + i, n, to[run].tile);
+      }
+    }
+  }
+
+  // Many cells are drawn without marking each dirty and the minimap is uploaded whole
+  bool many = cells.cells > 4096;
+  if (level->minimap && level->minimapTileset == level->tileset && level->tileset->colorsRevision == level->tileset->revision) {
+    for (const auto& span : cells.spans) {
+      for (uint32_t i = span.start; i < span.start + span.count; i++) {
+        if (many) level->drawMinimap(vec2i(i % level->width, i / level->width), tiles[i]);
+        else level->drawMinimap(vec2i(i % level->width, i / level->width));
+      }
+    }
+    if (many) level->minimapRevision++;
+  }
+  level->dirty = true;
+  level->account();
+}
+
+static void snapshot(Textures::Atlas* atlas, Edit& edit) {
+  edit.hasTileset = atlas->tileset, edit.hasColliders = atlas->tileset && atlas->tileset->colliders;
+  edit.patches = edit.hasTileset ? atlas->tileset->patches : vector<vec2i>();
+  edit.colliders = edit.hasColliders ? vector<bool>(atlas->tileset->colliders, atlas->tileset->colliders + atlas->width() * atlas->height()) : vector<bool>();
+}
+
+static void swapTileset(Edit& edit) {
+  Textures::Atlas* atlas = edit.atlas;
+  Edit now(TILESET);
+  snapshot(atlas, now);
+  if (atlas->tileset) delete[] atlas->tileset->colliders, delete atlas->tileset, atlas->tileset = nullptr;
+  if (edit.hasTileset) {
+    atlas->tileset = new Textures::Atlas::Tileset();
+    atlas->tileset->patches = edit.patches;
+    if (edit.hasColliders) {
+      atlas->tileset->colliders = new bool[atlas->width() * atlas->height()]();
+      for (int i = 0; i < min<int>(edit.colliders.size(), atlas->width() * atlas->height()); i++) atlas->tileset->colliders[i] = edit.colliders[i];
+    }
+  }
+  Journal::tileset(atlas);
+  if (atlas->tileset) {
+    for (vec2i patch : atlas->tileset->patches) Journal::patch(atlas, patch, true);
+    for (int i = 0; atlas->tileset->colliders && i < atlas->width() * atlas->height(); i++) {
+      if (atlas->tileset->colliders[i]) Journal::collider(atlas, i, true);
+    }
+  }
+  edit.hasTileset = now.hasTileset, edit.hasColliders = now.hasColliders;
+  edit.patches = std::move(now.patches), edit.colliders = std::move(now.colliders);
+  atlas->dirty = true;
+  atlas->account();
+}
+
+static void apply(Edit& edit, bool redo) {
+  TiledLevel::Level* level = edit.level;
+  Textures::Atlas* atlas = edit.atlas;
+  if (edit.op == TILES) apply(level, edit.cells, redo);
+  else if (edit.op == RESIZE) {
+    level->resize(redo ? edit.to : edit.from);
+    if (!redo) apply(level, edit.cells, false);
+  } else if (edit.op == OBJECT_ADD || edit.op == OBJECT_REMOVE) {
+    if ((edit.op == OBJECT_ADD) == redo) {
+      auto& properties = edit.parent->properties;
+      for (int i = edit.values.size(); i < properties.size(); i++) edit.values.push_back(properties[i].parsedDefault());
+      level->objects.insert(level->objects.begin() + min<int>(edit.index, level->objects.size()), TiledLevel::Object(edit.parent, edit.from, edit.values.data()));
+      Journal::objectAdded(level, edit.index);
+      for (int i = 0; i < properties.size(); i++) Journal::property(level, edit.index, i, Textures::formatValue(properties[i].type, edit.values[i]));
+    } else if (edit.index < level->objects.size()) {
+      const auto& object = level->objects[edit.index];
+      edit.from = object.pos, edit.values.clear();
+      for (int i = 0; i < object.parent->properties.size(); i++) edit.values.push_back(object.property(i));
+      level->objects.erase(level->objects.begin() + edit.index);
+      Journal::objectRemoved(level, edit.index);
+    }
+    level->dirty = true;
+    level->account();
+  } else if (edit.op == OBJECT_MOVE || edit.op == PROPERTY) {
+    if (edit.index >= level->objects.size()) return;
+    auto& object = level->objects[edit.index];
+    if (edit.op == OBJECT_MOVE) std::swap(object.pos, edit.from), Journal::objectMoved(level, edit.index);
+    else if (edit.property < object.parent->properties.size()) {
+      std::swap(object.property(edit.property), edit.values[0]);
+      Journal::property(level, edit.index, edit.property, Textures::formatValue(object.parent->properties[edit.property].type, object.property(edit.property)));
+    }
+    level->dirty = true;
+  } else if (edit.op == TILESET) {
+    swapTileset(edit);
+  } else if (edit.op == LEVEL_TILESET) {
+    std::swap(level->tileset, edit.atlas);
+    level->dirty = true;
+    Journal::levelTileset(level);
+  } else if (atlas->tileset) {
+    bool on = edit.on == redo;
+    if (edit.op == PATCH) {
+      if (on && !atlas->tileset->inPatch(edit.from)) atlas->tileset->patches.push_back(edit.from);
+      else if (!on) atlas->tileset->removePatch(edit.from);
+      Journal::patch(atlas, edit.from, on);
+    } else if (atlas->tileset->colliders && edit.index < atlas->width() * atlas->height()) {
+      atlas->tileset->colliders[edit.index] = on;
+      Journal::collider(atlas, edit.index, on);
+    }
+    atlas->dirty = true;
+  }
+}
+
+// An edit still being made is finished first, then undone whole
+static bool step(std::deque<Step>& from, std::deque<Step>& to, bool redo) {
+  commit();
+  if (from.empty()) return false;
+  PROFILE(redo ? "History::redo" : "History::undo");
+  Step step = std::move(from.back());
+  from.pop_back();
+  applying = true;
+  if (redo) {
+    for (auto& edit : step.edits) apply(edit, true);
+  } else {
+    for (int i = step.edits.size() - 1; i >= 0; i--) apply(step.edits[i], false);
+  }
+  applying = false;
+  bytes -= step.bytes;
+  step.measure();
+  bytes += step.bytes;
+  to.push_back(std::move(step));
+  memory.set(Memory::HISTORY, bytes);
+  return true;
+}
+
+bool undo() { return step(done, undone, false); }
+bool redo() { return step(undone, done, true); }
+
+void tile(TiledLevel::Level* level, vec2i pos, vec2i from, vec2i to) {
+  if (applying) return;
+  if (open.edits.empty() || open.edits.back().op != TILES || open.edits.back().level != level) {
+    open.edits.push_back(Edit(TILES));
+    open.edits.back().level = level;
+  }
+  open.edits.back().cells.add(pos.x + pos.y * level->width, from, to);
+  if (!depth) commit();
+}
+
+void cells(TiledLevel::Level* level, Cells&& cells) {
+  if (applying || !cells.cells) return;
+  Edit edit(TILES);
+  edit.level = level, edit.cells = std::move(cells);
+  record(std::move(edit));
+}
+
+// Resizing keeps the bottom rows, the cells it crops are kept to put back
+void resize(TiledLevel::Level* level, vec2i size) {
+  if (applying) return;
+  Edit edit(RESIZE);
+  edit.level = level, edit.from = level->size(), edit.to = size;
+  vec2i* tiles = level->tiles();
+  for (int y = 0; y < level->height; y++) {
+    for (int x = 0; x < level->width; x++) {
+      if (x >= size.x || level->height - y - 1 >= size.y) edit.cells.add(x + y * level->width, tiles[x + y * level->width], -1);
+    }
+  }
+  record(std::move(edit));
+}
+
+void objectAdded(TiledLevel::Level* level, int index) {
+  if (applying) return;
+  Edit edit(OBJECT_ADD);
+  edit.level = level, edit.index = index, edit.parent = level->objects[index].parent, edit.from = level->objects[index].pos;
+  record(std::move(edit));
+}
+
+void objectRemoved(TiledLevel::Level* level, int index) {
+  if (applying) return;
+  const auto& object = level->objects[index];
+  Edit edit(OBJECT_REMOVE);
+  edit.level = level, edit.index = index, edit.parent = object.parent, edit.from = object.pos;
+  for (int i = 0; i < object.parent->properties.size(); i++) edit.values.push_back(object.property(i));
+  record(std::move(edit));
+}
+
+void objectMoved(TiledLevel::Level* level, int index, vec2i from) {
+  if (applying) return;
+  Edit edit(OBJECT_MOVE);
+  edit.level = level, edit.index = index, edit.from = from;
+  record(std::move(edit));
+}
+
+// Typing into a field edits it every keystroke, those are one step as long as nothing else happens in between
+void property(TiledLevel::Level* level, int index, int property, Textures::Value before) {
+  if (applying) return;
+  if (!depth && open.edits.empty() && undone.empty() && !done.empty() && done.back().edits.size() == 1) {
+    const Edit& last = done.back().edits[0];
+    if (last.op == PROPERTY && last.level == level && last.index == index && last.property == property) return;
+  }
+  Edit edit(PROPERTY);
+  edit.level = level, edit.index = index, edit.property = property, edit.values = {before};
+  record(std::move(edit));
+}
+
+void patch(Textures::Atlas* atlas, vec2i patch, bool added) {
+  if (applying) return;
+  Edit edit(PATCH);
+  edit.atlas = atlas, edit.from = patch, edit.on = added;
+  record(std::move(edit));
+}
+
+void collider(Textures::Atlas* atlas, int index, bool solid) {
+  if (applying) return;
+  Edit edit(COLLIDER);
+  edit.atlas = atlas, edit.index = index, edit.on = solid;
+  record(std::move(edit));
+}
+
+void tileset(Textures::Atlas* atlas) {
+  if (applying) return;
+  Edit edit(TILESET);
+  edit.atlas = atlas;
+  snapshot(atlas, edit);
+  record(std::move(edit));
+}
+
+void levelTileset(TiledLevel::Level* level) {
+  if (applying) return;
+  Edit edit(LEVEL_TILESET);
+  edit.level = level, edit.atlas = level->tileset;
+  record(std::move(edit));
+}
+}  // namespace History
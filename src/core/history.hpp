@@ -0,0 +1,70 @@
+#pragma once
+#include "base.hpp"
+#include "memory.hpp"
+
+namespace Textures {
+struct Atlas;
+union Value;
+}
+namespace TiledLevel {
+struct Level;
+}
+
+// Undo and redo, kept as the edits themselves rather than snapshots. Edits between begin() and end(), a stroke or a
+// drag, are undone together, the rest one by one. Once the history holds more than budget bytes the oldest steps go
+namespace History {
+// Cells changed in one level, as spans of consecutive cells with the tiles they had before and after run-length
+// encoded, so filling a million cells with one tile costs a few runs per row. Cells are in the order they changed
+struct Cells {
+  struct Span {
+    uint32_t start, count;
+  };
+  struct Run {
+    vec2i tile;
+    uint32_t count;
+  };
+  vector<Span> spans;
+  vector<Run> before, after;
+  size_t cells = 0;
+
+  void add(uint32_t index, vec2i from, vec2i to) {
+    if (!spans.empty() && spans.back().start + spans.back().count == index) spans.back().count++;
+    else spans.push_back({index, 1});
+    push(before, from), push(after, to);
+    cells++;
+  }
+  static void push(vector<Run>& runs, vec2i tile) {
+    if (!runs.empty() && runs.back().tile == tile) runs.back().count++;
+    else runs.push_back({tile, 1});
+  }
+  size_t bytes() const { return spans.capacity() * sizeof(Span) + (before.capacity() + after.capacity()) * sizeof(Run); }
+};
+
+extern size_t budget;  // 64 MB by default
+extern Memory::Account memory;
+
+void begin();
+void end();
+void clear();
+bool canUndo();
+bool canRedo();
+// False if there was nothing to undo or redo. Object indices change, so don't hold pointers to objects across them
+bool undo();
+bool redo();
+
+// Writes the cells' tiles after the change, or before it when undoing, with tile counts, journal and minimap following
+void apply(TiledLevel::Level* level, const Cells& cells, bool redo);
+
+// Recorded after the change, except those that need what the change is about to lose
+void tile(TiledLevel::Level* level, vec2i pos, vec2i from, vec2i to);
+void cells(TiledLevel::Level* level, Cells&& cells);
+void resize(TiledLevel::Level* level, vec2i size);  // Before
+void objectAdded(TiledLevel::Level* level, int index);
+void objectRemoved(TiledLevel::Level* level, int index);  // Before
+void objectMoved(TiledLevel::Level* level, int index, vec2i from);
+void property(TiledLevel::Level* level, int index, int property, Textures::Value before);
+void patch(Textures::Atlas* atlas, vec2i patch, bool added);
+void collider(Textures::Atlas* atlas, int index, bool solid);
+void tileset(Textures::Atlas* atlas);  // Before
+void levelTileset(TiledLevel::Level* level);  // Before
+}  // namespace History
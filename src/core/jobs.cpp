@@ -0,0 +1,92 @@
+#include "jobs.hpp"
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <condition_variable>
+
+namespace Jobs {
+static struct Pool {
+  std::vector<std::thread> workers;
+  std::deque<std::function<void()>> queue;
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool stopping = false;
+
+  void start() {
+    int count = std::max<int>(std::thread::hardware_concurrency(), 2) - 1;
+    for (int i = 0; i < count; i++) {
+      workers.emplace_back([this] {
+        while (true) {
+          std::function<void()> task;
+          {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty()) return;
+            task = std::move(queue.front());
+            queue.pop_front();
+          }
+          task();
+        }
+      });
+    }
+  }
+
+  void submit(std::function<void()> task) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (workers.empty()) start();
+    queue.push_back(std::move(task));
+    wake.notify_one();
+  }
+
+  ~Pool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) worker.join();
+  }
+} pool;
+
+// Shared with the helpers, so a helper that only gets scheduled after everything is done doesn't touch a dead stack frame
+struct Batch {
+  std::function<void(size_t)> job;
+  size_t count;
+  std::atomic<size_t> next = 0, done = 0;
+  std::mutex mutex;
+  std::condition_variable finished;
+  std::exception_ptr error;
+
+  void drain() {
+    for (size_t i; (i = next++) < count;) {
+      try {
+        job(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error) error = std::current_exception();
+      }
+      if (++done == count) {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished.notify_all();
+      }
+    }
+  }
+};
+
+int threads() { return std::max<int>(std::thread::hardware_concurrency(), 2); }
+
+void parallelFor(size_t count, const std::function<void(size_t)>& job) {
+  if (count == 0) return;
+  auto batch = std::make_shared<Batch>();
+  batch->job = job, batch->count = count;
+  for (size_t i = 0; i < std::min<size_t>(count, threads()) - 1; i++) pool.submit([batch] { batch->drain(); });
+  batch->drain();
+
+  std::unique_lock<std::mutex> lock(batch->mutex);
+  batch->finished.wait(lock, [&] { return batch->done == batch->count; });
+  if (batch->error) std::rethrow_exception(batch->error);
+}
+}  // namespace Jobs
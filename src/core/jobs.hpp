@@ -0,0 +1,9 @@
+#pragma once
+#include <functional>
+
+namespace Jobs {
+int threads();
+// Runs job(0) .. job(count - 1) on the worker pool and the calling thread and returns once all of them are done.
+// Rethrows the first exception thrown by a job
+void parallelFor(size_t count, const std::function<void(size_t)>& job);
+}  // namespace Jobs
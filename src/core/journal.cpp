@@ -0,0 +1,334 @@
+#include "assets.hpp"
+#include <chrono>
+#include <climits>
+#include <unordered_map>
+
+namespace Journal {
+enum Op : uint8_t { NAME, TILE, RESIZE, NEW_LEVEL, OBJECT_ADD, OBJECT_REMOVE, PROPERTY, PATCH, COLLIDER, TILESET, TILES, OBJECT_INSERT, OBJECT_MOVE, LEVEL_TILESET };
+enum Kind : uint8_t { LEVEL, ATLAS, CLASS, PROPERTY_NAME };
+
+// Each save starts a new generation, older ones are deleted once that save is on disk
+static int generation = -1;
+static std::string folder;  // Of the project being journaled, projectSaveDirectory moves on with Save as
+static FILE* file = nullptr;
+static std::string buffer;
+static std::unordered_map<std::string, uint32_t> ids[4];
+static bool replaying = false;
+static auto lastSync = std::chrono::steady_clock::now();
+
+static std::string path(const std::string& folder, int generation) { return folder + format(".journal.%d", generation); }
+static std::string path(int generation) { return path(folder, generation); }
+
+static vector<int> generations(const std::string& folder) {
+  vector<int> found;
+  if (folder.empty() || !fs::exists(folder)) return found;
+  for (const auto& entry : fs::directory_iterator(folder)) {
+    std::string name = entry.path().filename().string();
+    if (name.rfind(".journal.", 0) == 0) found.push_back(std::atoi(name.c_str() + 9));
+  }
+  std::sort(found.begin(), found.end());
+  return found;
+}
+
+static void varint(uint64_t value) {
+  while (value >= 0x80) buffer += char(value & 0x7f | 0x80), value >>= 7;
+  buffer += char(value);
+}
+
+static void svarint(int64_t value) { varint(uint64_t(value) << 1 ^ uint64_t(value >> 63)); }
+
+// Names are written once per generation, records refer to them by index
+static uint32_t id(Kind kind, const std::string& name) {
+  auto [it, inserted] = ids[kind].try_emplace(name, ids[kind].size());
+  if (inserted) buffer += char(NAME), buffer += char(kind), varint(it->second), buffer += name, buffer += '\0';
+  return it->second;
+}
+
+static bool recording() { return file && !replaying; }
+
+static void flush() {
+  PROFILE("Journal::flush");
+  if (!file || buffer.empty()) return;
+  fwrite(buffer.data(), buffer.size(), 1, file);
+  Saver::sync(file);
+  buffer.clear();
+  lastSync = std::chrono::steady_clock::now();
+}
+
+static void start(int generation) {
+  Journal::generation = generation;
+  file = fopen(path(generation).c_str(), "ab");
+  for (auto& table : ids) table.clear();
+}
+
+struct Reader {
+  std::string data;
+  size_t cursor = 0;
+  bool ok = true;
+
+  uint64_t varint() {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (cursor >= data.size()) return ok = false, 0;
+      uint8_t byte = data[cursor++];
+      value |= uint64_t(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) return value;
+    }
+    return ok = false, 0;
+  }
+
+  int64_t svarint() {
+    uint64_t value = varint();
+    return int64_t(value >> 1) ^ -int64_t(value & 1);
+  }
+
+  std::string str() {
+    size_t end = data.find('\0', cursor);
+    if (end == std::string::npos) return ok = false, "";
+    std::string value = data.substr(cursor, end - cursor);
+    cursor = end + 1;
+    return value;
+  }
+};
+
+static TiledLevel::Level* findLevel(const std::string& name) {
+  for (const auto level : TiledLevel::levels) {
+    if (level->name == name) return level;
+  }
+  return nullptr;
+}
+
+// Stops at the first truncated record, that's where the crash happened
+static void replay(int generation) {
+  Reader in;
+  {
+    File journal(path(generation), "rb");
+    if (!journal()) return;
+    char chunk[4096];
+    for (size_t read; (read = fread(chunk, 1, sizeof(chunk), journal())) > 0;) in.data.append(chunk, read);
+  }
+
+  vector<std::string> names[4];
+  auto name = [&](Kind kind) -> std::string {
+    uint64_t index = in.varint();
+    return index < names[kind].size() ? names[kind][index] : "";
+  };
+
+  while (in.ok && in.cursor < in.data.size()) {
+    uint8_t op = in.data[in.cursor++];
+    if (op == NAME) {
+      uint8_t kind = in.cursor < in.data.size() ? in.data[in.cursor++] : 0xff;
+      uint64_t index = in.varint();
+      std::string value = in.str();
+      if (!in.ok || kind > PROPERTY_NAME) break;
+      if (names[kind].size() <= index) names[kind].resize(index + 1);
+      names[kind][index] = value;
+      continue;
+    }
+
+    if (op == TILE) {
+      auto level = findLevel(name(LEVEL));
+      uint64_t x = in.varint(), y = in.varint(), tile = in.varint();
+      if (!in.ok) break;
+      if (level && level->tileset && x < level->width && y < level->height) {
+        level->setTile(vec2i(x, y), tile ? vec2i((tile - 1) % level->tileset->width(), (tile - 1) / level->tileset->width()) : vec2i(-1));
+      }
+    } else if (op == TILES) {
+      auto level = findLevel(name(LEVEL));
+      uint64_t start = in.varint(), count = in.varint(), tile = in.varint();
+      if (!in.ok) break;
+      if (level && level->tileset && start + count <= uint64_t(level->width) * level->height) {
+        vec2i value = tile ? vec2i((tile - 1) % level->tileset->width(), (tile - 1) / level->tileset->width()) : vec2i(-1);
+        for (uint64_t i = start; i < start + count; i++) level->setTile(vec2i(i % level->width, i / level->width), value);
+      }
+    } else if (op == RESIZE) {
+      auto level = findLevel(name(LEVEL));
+      uint64_t width = in.varint(), height = in.varint();
+      if (!in.ok) break;
+      if (level) level->resize(vec2i(width, height));
+    } else if (op == NEW_LEVEL) {
+      std::string levelName = name(LEVEL);
+      auto tileset = Textures::atlasNames.find(name(ATLAS));
+      uint64_t width = in.varint(), height = in.varint();
+      if (!in.ok) break;
+      if (!findLevel(levelName) && tileset) TiledLevel::levels.push_back(new TiledLevel::Level(levelName, tileset, width, height));
+    } else if (op == OBJECT_ADD || op == OBJECT_INSERT) {
+      auto level = findLevel(name(LEVEL));
+      auto parent = Textures::objectNames.find(name(CLASS));
+      int64_t x = in.svarint(), y = in.svarint();
+      uint64_t index = op == OBJECT_INSERT ? in.varint() : -1;
+      if (!in.ok) break;
+      if (level && parent) level->objects.insert(level->objects.begin() + min<uint64_t>(index, level->objects.size()), TiledLevel::Object(parent, vec2i(x, y))), level->dirty = true;
+    } else if (op == OBJECT_MOVE) {
+      auto level = findLevel(name(LEVEL));
+      uint64_t index = in.varint();
+      int64_t x = in.svarint(), y = in.svarint();
+      if (!in.ok) break;
+      if (level && index < level->objects.size()) level->objects[index].pos = vec2i(x, y), level->dirty = true;
+    } else if (op == OBJECT_REMOVE) {
+      auto level = findLevel(name(LEVEL));
+      uint64_t index = in.varint();
+      if (!in.ok) break;
+      if (level && index < level->objects.size()) level->objects.erase(level->objects.begin() + index), level->dirty = true;
+    } else if (op == PROPERTY) {
+      auto level = findLevel(name(LEVEL));
+      uint64_t index = in.varint();
+      std::string propertyName = name(PROPERTY_NAME), value = in.str();
+      if (!in.ok) break;
+      if (!level || index >= level->objects.size()) continue;
+      // By name, the class on disk may have had its properties added, removed or reordered since
+      auto& object = level->objects[index];
+      for (int i = 0; i < object.parent->properties.size(); i++) {
+        if (object.parent->properties[i].name != propertyName) continue;
+        Textures::parseValue(object.parent->properties[i].type, value, object.property(i));
+        level->dirty = true;
+        break;
+      }
+    } else if (op == LEVEL_TILESET) {
+      auto level = findLevel(name(LEVEL));
+      auto tileset = Textures::atlasNames.find(name(ATLAS));
+      if (!in.ok) break;
+      if (level && tileset) level->tileset = tileset, level->dirty = true;
+    } else if (op == PATCH || op == COLLIDER || op == TILESET) {
+      auto atlas = Textures::atlasNames.find(name(ATLAS));
+      uint64_t a = in.varint(), b = op == PATCH ? in.varint() : 0, on = op == TILESET ? 0 : in.varint();
+      if (!in.ok) break;
+      if (!atlas) continue;
+      if (op == TILESET) {
+        if (bool(a & 1) != bool(atlas->tileset)) {
+          if (atlas->tileset) delete[] atlas->tileset->colliders, delete atlas->tileset, atlas->tileset = nullptr;
+          else atlas->tileset = new Textures::Atlas::Tileset();
+        }
+        if (atlas->tileset && bool(a & 2) != bool(atlas->tileset->colliders)) {
+          if (atlas->tileset->colliders) delete[] atlas->tileset->colliders, atlas->tileset->colliders = nullptr;
+          else atlas->tileset->colliders = new bool[atlas->width() * atlas->height()]();
+        }
+      } else if (!atlas->tileset) {
+        continue;
+      } else if (op == PATCH) {
+        if (on && !atlas->tileset->inPatch(vec2i(a, b))) atlas->tileset->patches.push_back(vec2i(a, b));
+        else if (!on) atlas->tileset->removePatch(vec2i(a, b));
+      } else if (atlas->tileset->colliders && a < atlas->width() * atlas->height()) {
+        atlas->tileset->colliders[a] = on;
+      }
+      atlas->dirty = true;
+    } else break;
+  }
+}
+
+void open() {
+  close();
+  folder = projectSaveDirectory;
+  if (folder.empty()) return;
+  vector<int> left = generations(folder);
+  replaying = true;
+  for (int generation : left) replay(generation);
+  replaying = false;
+
+  // Replayed generations stay on disk until a save covers them
+  start(left.empty() ? 0 : left.back() + 1);
+}
+
+void close(bool discard) {
+  if (!file) return;
+  if (!discard) flush();
+  fclose(file), file = nullptr;
+  buffer.clear();
+  if (discard) commit(folder, INT_MAX);
+}
+
+int rotate() {
+  if (!file) return -1;
+  flush();
+  fclose(file);
+  int covered = generation;
+  start(generation + 1);
+  return covered;
+}
+
+void commit(const std::string& folder, int covered) {
+  for (int generation : generations(folder)) {
+    if (generation <= covered) fs::remove(path(folder, generation));
+  }
+}
+
+void update() {
+  if (buffer.empty()) return;
+  if (buffer.size() > 64 * 1024 || std::chrono::steady_clock::now() - lastSync > std::chrono::seconds(2)) flush();
+}
+
+void tile(TiledLevel::Level* level, vec2i pos, vec2i tile) {
+  if (!recording()) return;
+  uint32_t levelId = id(LEVEL, level->name);
+  buffer += char(TILE), varint(levelId), varint(pos.x), varint(pos.y), varint(tile == -1 ? 0 : level->tileset->toIndex(tile) + 1);
+}
+
+void tiles(TiledLevel::Level* level, uint32_t start, uint32_t count, vec2i tile) {
+  if (!recording()) return;
+  uint32_t levelId = id(LEVEL, level->name);
+  buffer += char(TILES), varint(levelId), varint(start), varint(count), varint(tile == -1 ? 0 : level->tileset->toIndex(tile) + 1);
+}
+
+void resize(TiledLevel::Level* level) {
+  if (!recording()) return;
+  uint32_t levelId = id(LEVEL, level->name);
+  buffer += char(RESIZE), varint(levelId), varint(level->width), varint(level->height);
+}
+
+void newLevel(TiledLevel::Level* level) {
+  if (!recording()) return;
+  uint32_t levelId = id(LEVEL, level->name), atlasId = id(ATLAS, level->tileset->name);
+  buffer += char(NEW_LEVEL), varint(levelId), varint(atlasId), varint(level->width), varint(level->height);
+}
+
+void objectAdded(TiledLevel::Level* level, int index) {
+  if (!recording()) return;
+  const auto& object = level->objects[index];
+  uint32_t levelId = id(LEVEL, level->name), classId = id(CLASS, object.parent->name);
+  bool last = index + 1 == level->objects.size();  // Anywhere else when undoing a removal
+  buffer += char(last ? OBJECT_ADD : OBJECT_INSERT), varint(levelId), varint(classId), svarint(object.pos.x), svarint(object.pos.y);
+  if (!last) varint(index);
+}
+
+void objectRemoved(TiledLevel::Level* level, int index) {
+  if (!recording()) return;
+  uint32_t levelId = id(LEVEL, level->name);
+  buffer += char(OBJECT_REMOVE), varint(levelId), varint(index);
+}
+
+void objectMoved(TiledLevel::Level* level, int index) {
+  if (!recording()) return;
+  uint32_t levelId = id(LEVEL, level->name);
+  buffer += char(OBJECT_MOVE), varint(levelId), varint(index), svarint(level->objects[index].pos.x), svarint(level->objects[index].pos.y);
+}
+
+void property(TiledLevel::Level* level, int index, int property, const std::string& value) {
+  if (!recording()) return;
+  uint32_t levelId = id(LEVEL, level->name), propertyId = id(PROPERTY_NAME, level->objects[index].parent->properties[property].name);
+  buffer += char(PROPERTY), varint(levelId), varint(index), varint(propertyId), buffer += value, buffer += '\0';
+}
+
+void levelTileset(TiledLevel::Level* level) {
+  if (!recording()) return;
+  uint32_t levelId = id(LEVEL, level->name), atlasId = id(ATLAS, level->tileset->name);
+  buffer += char(LEVEL_TILESET), varint(levelId), varint(atlasId);
+}
+
+void patch(Textures::Atlas* atlas, vec2i patch, bool added) {
+  if (!recording()) return;
+  uint32_t atlasId = id(ATLAS, atlas->name);
+  buffer += char(PATCH), varint(atlasId), varint(patch.x), varint(patch.y), varint(added);
+}
+
+void collider(Textures::Atlas* atlas, int index, bool solid) {
+  if (!recording()) return;
+  uint32_t atlasId = id(ATLAS, atlas->name);
+  buffer += char(COLLIDER), varint(atlasId), varint(index), varint(solid);
+}
+
+void tileset(Textures::Atlas* atlas) {
+  if (!recording()) return;
+  uint32_t atlasId = id(ATLAS, atlas->name);
+  buffer += char(TILESET), varint(atlasId), varint((atlas->tileset != nullptr) | (atlas->tileset && atlas->tileset->colliders) << 1);
+}
+}  // namespace Journal
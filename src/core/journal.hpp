@@ -0,0 +1,36 @@
+#pragma once
+#include "base.hpp"
+
+namespace Textures {
+struct Atlas;
+}
+namespace TiledLevel {
+struct Level;
+}
+
+// Append-only log of every edit since the last save, a few bytes per edit. Replayed when a project is opened after a
+// crash, dropped once a save covering it has been written
+namespace Journal {
+void open();
+// Without discard the generations stay on disk, for a commit() once a save covering them is written
+void close(bool discard = true);
+int rotate();
+// Deletes the generations up to covered of the project in folder, the one journaled when the save started
+void commit(const std::string& folder, int covered);
+void update();
+
+void tile(TiledLevel::Level* level, vec2i pos, vec2i tile);
+// count cells from index start, row by row, all showing tile
+void tiles(TiledLevel::Level* level, uint32_t start, uint32_t count, vec2i tile);
+void resize(TiledLevel::Level* level);
+void newLevel(TiledLevel::Level* level);
+void levelTileset(TiledLevel::Level* level);
+void objectAdded(TiledLevel::Level* level, int index);
+void objectRemoved(TiledLevel::Level* level, int index);
+void objectMoved(TiledLevel::Level* level, int index);
+// Keyed by the property's name, so a schema change saved after the edit doesn't land the value on another property
+void property(TiledLevel::Level* level, int index, int property, const std::string& value);
+void patch(Textures::Atlas* atlas, vec2i patch, bool added);
+void collider(Textures::Atlas* atlas, int index, bool solid);
+void tileset(Textures::Atlas* atlas);
+}  // namespace Journal
@@ -0,0 +1,412 @@
+#include "assets.hpp"
+#include <map>
+#include <unordered_map>
+
+namespace TiledLevel {
+vector<Level*> levels;
+
+// Rebuilt when the levels drawn with the atlas, their usage revisions or the atlas size differ from last time
+struct UsedTiles {
+  vector<std::pair<const Level*, uint32_t>> levels;
+  int tiles = -1;
+  vector<uint8_t> used;
+};
+static std::unordered_map<const Textures::Atlas*, UsedTiles> usedTilesCache;
+
+void markDirty(const Textures::Atlas* tileset) {
+  for (const auto level : levels) {
+    if (level->tileset == tileset) level->dirty = true;
+  }
+}
+
+void markDirty(const Textures::ObjectClass* parent) {
+  for (const auto level : levels) {
+    for (const auto& object : level->objects) {
+      if (object.parent == parent) {
+        level->dirty = true;
+        break;
+      }
+    }
+  }
+}
+
+void save(vector<Saver::Job>& jobs) {
+  for (const auto level : levels) {
+    if (level->dirty) level->save(jobs);
+  }
+}
+
+void clear() {
+  History::clear();  // It points at the levels and atlases about to go
+  usedTilesCache.clear();
+  for (const auto level : levels) delete level;
+  levels.clear();
+}
+
+void load() {
+  clear();
+  vector<std::string> names;
+  for (const auto& entry : fs::directory_iterator(projectSaveDirectory + "levels/")) {
+    if (entry.path().extension() == ".lvl") names.push_back(entry.path().stem().string());
+  }
+  std::sort(names.begin(), names.end(), [](const std::string& a, const std::string& b) { return strcmp(a, b); });
+  Project::toLoad += names.size();
+  levels.resize(names.size());
+  Jobs::parallelFor(names.size(), [&](size_t i) { levels[i] = new Level(names[i]), Project::loaded++; });
+}
+
+// Tiles are packed like usage keys, with empty cells as all ones
+static uint32_t pack(vec2i tile) { return tile == -1 ? UINT32_MAX : Level::usageKey(tile); }
+static vec2i unpack(uint32_t key) { return key == UINT32_MAX ? vec2i(-1) : vec2i(key & 0xffff, key >> 16); }
+
+static void varint(std::string& out, uint32_t value) {
+  while (value >= 0x80) out += char(value & 0x7f | 0x80), value >>= 7;
+  out += char(value);
+}
+
+std::string encodeTiles(const vec2i* tiles, uint32_t width, uint32_t height) {
+  PROFILE("TiledLevel::encodeTiles");
+  std::string out, runs;
+  for (uint32_t y = 0; y < height; y++) {
+    const vec2i* row = tiles + size_t(y) * width;
+    if (y && std::equal(row, row + width, row - width)) {
+      out += '\0';
+      continue;
+    }
+    runs.clear();
+    uint32_t count = 0, previous = UINT32_MAX;
+    for (uint32_t x = 0, end; x < width; x = end, count++) {
+      for (end = x + 1; end < width && row[end] == row[x];) end++;
+      int32_t delta = pack(row[x]) - previous;
+      varint(runs, end - x), varint(runs, uint32_t(delta) << 1 ^ uint32_t(delta >> 31));
+      previous = pack(row[x]);
+    }
+    varint(out, count);
+    out += runs;
+  }
+  return out;
+}
+
+// Reads the file a block at a time and never past the tiles
+struct TileReader {
+  FILE* file;
+  uint32_t left;
+  vector<uint8_t> buffer;
+  size_t pos = 0, end = 0;
+  bool ok = true;
+
+  TileReader(FILE* file, uint32_t bytes) : file(file), left(bytes), buffer(min(bytes, 1u << 16)) {}
+
+  uint8_t byte() {
+    if (pos == end) {
+      end = left ? fread(buffer.data(), 1, min<size_t>(left, buffer.size()), file) : 0, pos = 0;
+      if (!end) return ok = false, 0;
+      left -= end;
+    }
+    return buffer[pos++];
+  }
+
+  uint32_t varint() {
+    uint32_t value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+      uint8_t next = byte();
+      value |= uint32_t(next & 0x7f) << shift;
+      if (!(next & 0x80)) return value;
+    }
+    return ok = false, 0;
+  }
+};
+
+bool decodeTiles(FILE* file, uint32_t bytes, uint32_t width, uint32_t height, vec2i* grid, const std::function<void(const vec2i* row, uint32_t y)>& row) {
+  PROFILE("TiledLevel::decodeTiles");
+  TileReader in(file, bytes);
+  vector<vec2i> rows(grid ? 0 : width * 2);
+  for (uint32_t y = 0; y < height; y++) {
+    vec2i* cells = grid ? grid + size_t(y) * width : rows.data() + (y & 1) * width;
+    const vec2i* above = grid ? cells - width : rows.data() + (~y & 1) * width;
+    uint32_t runs = in.varint(), x = 0, previous = UINT32_MAX;
+    if (in.ok && !runs && y) std::copy(above, above + width, cells), x = width;
+    for (uint32_t i = 0; in.ok && i < runs; i++) {
+      uint32_t length = in.varint(), zigzag = in.varint();
+      previous += int32_t(zigzag >> 1) ^ -int32_t(zigzag & 1);
+      if (!length || length > width - x) break;
+      std::fill(cells + x, cells + x + length, unpack(previous));
+      x += length;
+    }
+    if (!in.ok || x != width) {
+      if (grid) std::fill(cells, grid + size_t(width) * height, vec2i(-1));
+      return false;
+    }
+    if (row) row(cells, y);
+  }
+  return true;
+}
+
+// Patches are drawn as four quarters, each picking the edge, corner or inner piece by which neighbours continue the patch
+static bool concatX(Level* level, vec2i tile, vec2i pos, int dir) { return inRange(pos.x + dir, 0, (int)level->width) && level->getTile(pos + vec2i(dir, 0)) == level->tileset->tileset->patch(tile); }
+static bool concatY(Level* level, vec2i tile, vec2i pos, int dir) { return inRange(pos.y + dir, 0, (int)level->height) && level->getTile(pos + vec2i(0, dir)) == level->tileset->tileset->patch(tile); }
+
+// Offset from the patch's first tile: 0 if the patch continues both ways, 1 neither, 2 only sideways, 3 only up or down
+static int piece(Level* level, vec2i tile, vec2i pos, vec2i quater) {
+  vec2i delta = quater * 2 - 1;
+  if (!concatX(level, tile, pos, delta.x)) return concatY(level, tile, pos, delta.y) ? 3 : 1;
+  return concatY(level, tile, pos, delta.y) ? 0 : 2;
+}
+
+static void drawQuater(MvDrawTarget& viewport, Level* level, vec2i pos, vec2i tile, vec2f screen, vec2f tileScreenSize, vec2i quater) {
+  tile.x += piece(level, tile, pos, quater);
+  viewport.drawImage(level->tileset->image(), floor(screen + quater * tileScreenSize / 2), ceil(tileScreenSize / 2), (tile * 2 + quater) * level->tileset->tilesize / 2, level->tileset->tilesize / 2);
+}
+
+static void drawPatch(MvDrawTarget& viewport, Level* level, vec2i pos, vec2i tile, vec2i screen, vec2i tileScreenSize) {
+  drawQuater(viewport, level, pos, tile, screen, tileScreenSize, vec2i(0, 0));
+  drawQuater(viewport, level, pos, tile, screen, tileScreenSize, vec2i(1, 0));
+  drawQuater(viewport, level, pos, tile, screen, tileScreenSize, vec2i(0, 1));
+  drawQuater(viewport, level, pos, tile, screen, tileScreenSize, vec2i(1, 1));
+}
+
+void render(MvImage& viewport, Level* level, vec2f camera, float scale) {
+  PROFILE("TiledLevel::render");
+  viewport.clear(MvColor::black);
+  vec2f tileScreenSize = level->tileset->tilesize * scale;
+  viewport.fillRect(-camera, tileScreenSize * level->size(), MvColor(135, 206, 235));
+  for (int x = max(camera.x / tileScreenSize.x, 0); x <= min((camera.x + viewport.width) / tileScreenSize.x, level->width - 1); x++) {
+    for (int y = max(camera.y / tileScreenSize.y, 0); y <= min((camera.y + viewport.height) / tileScreenSize.y, level->height - 1); y++) {
+      vec2i tile = level->getTile(vec2i(x, y));
+      vec2f screen = vec2f(x, y) * tileScreenSize - camera;
+      if (tile != -1) {
+        if (level->tileset->tileset->inPatch(tile)) drawPatch(viewport, level, vec2i(x, y), level->tileset->tileset->patch(tile), screen, tileScreenSize);
+        else viewport.drawImage(level->tileset->image(), screen, tileScreenSize, tile * level->tileset->tilesize, level->tileset->tilesize);
+      }
+    }
+  }
+  for (const auto& object : level->objects) {
+    viewport.drawImage(object.parent->atlas->image(), (vec2f)object.pos / level->tileset->tilesize * tileScreenSize - camera, object.parent->atlas->tilesize * scale, 0, object.parent->atlas->tilesize);
+  }
+}
+
+uint8_t quarters(Level* level, vec2i pos) {
+  vec2i tile = level->getTile(pos);
+  if (tile == -1 || !level->tileset->tileset || !level->tileset->tileset->inPatch(tile)) return 0;
+  tile = level->tileset->tileset->patch(tile);
+  uint8_t pieces = 0;
+  for (int quarter = 0; quarter < 4; quarter++) pieces |= piece(level, tile, pos, vec2i(quarter % 2, quarter / 2)) << (quarter * 2);
+  return pieces;
+}
+
+std::string exportData(ExportOrder cells, bool bakeQuarters, bool stripUnused) {
+  std::string data = cells == ExportOrder::ROWS ? "" : format("#define ORE_LEVELS_LAYOUT %d\n", (int)cells);
+  if (bakeQuarters) data += "#define ORE_LEVELS_QUARTERS 1\n";
+  data += "const uint8_t PROGMEM levels[] = {\n  ";
+  data += itobytes(levels.size(), 2);
+  std::map<const Textures::Atlas*, vector<int>> remaps;
+  for (const auto level : levels) {
+    if (stripUnused && !remaps.count(level->tileset)) remaps[level->tileset] = exportedTiles(level->tileset);
+    data += itobytes(level->width, 2);
+    data += itobytes(level->height, 2);
+    for (int i = 0; i < level->width * level->height; i++) {
+      vec2i pos = cells == ExportOrder::ROWS ? vec2i(i % level->width, i / level->width) : vec2i(i / level->height, i % level->height);
+      vec2i tile = level->getTile(pos);
+      if (bakeQuarters && tile != -1 && level->tileset->tileset && level->tileset->tileset->inPatch(tile)) tile = level->tileset->tileset->patch(tile);
+      // A cell left pointing past its atlas, by a smaller atlas or a tileset change, exports empty
+      bool inAtlas = inRange(tile.x, 0, level->tileset->width()) && inRange(tile.y, 0, level->tileset->height());
+      int index = !inAtlas ? -1 : stripUnused ? remaps[level->tileset][level->tileset->toIndex(tile)] : level->tileset->toIndex(tile);
+      if (tile != -1 && index == -1) Textures::reportMissing(format("Level %s: tile %d, %d at %d, %d is not in %s", level->name.c_str(), tile.x, tile.y, pos.x, pos.y, level->tileset->name.c_str()));
+      data += index == -1 ? "0, " : itobytes(index + 1, 1);
+      if (bakeQuarters) data += itobytes(quarters(level, pos), 1);
+    }
+    uint32_t objectsDataSizeInsert = data.size();
+    data += itobytes(level->objects.size(), 2);
+    for (const auto& object : level->objects) {
+      data += itobytes(object.pos.x, 2) + itobytes(object.pos.y, 2);
+      data += itobytes(object.parent->index, 2);
+      for (int i = 0; i < object.parent->properties.size(); i++) {
+        auto type = object.parent->properties[i].type;
+        if (type == Textures::PropertyType::INT) data += itobytes(object.property(i).i, 4);
+        else if (type == Textures::PropertyType::STRING) {
+          for (auto character : Strings::get(object.property(i).s)) data += format("%d, ", (uint8_t)character);
+          data += "0, ";
+        }
+      }
+    }
+    data.insert(objectsDataSizeInsert, itobytes(std::count(data.begin() + objectsDataSizeInsert, data.end(), ','), 4));
+  }
+  for (int i = 0; i < 2; i++) data.pop_back();
+  data += "\n};";
+  return data;
+}
+
+// Greedy meshing: the first free solid cell grows right, then down while the whole span below is solid and free
+Collision collision(Level* level) {
+  PROFILE("TiledLevel::collision");
+  Collision collision;
+  const auto tileset = level->tileset;
+  if (!tileset || !tileset->tileset || !tileset->tileset->colliders) return collision;
+  vec2i* tiles = level->tiles();
+  int width = level->width, height = level->height;
+  vector<uint8_t> solid(width * height);
+  for (int i = 0; i < width * height; i++) {
+    vec2i tile = tiles[i];
+    solid[i] = tile != -1 && inRange(tile.x, 0, tileset->width()) && inRange(tile.y, 0, tileset->height()) && tileset->tileset->colliders[tileset->toIndex(tile)];
+  }
+
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      if (!solid[x + y * width]) continue;
+      int w = 1, h = 1;
+      while (x + w < width && solid[x + w + y * width]) w++;
+      while (y + h < height && std::all_of(solid.begin() + x + (y + h) * width, solid.begin() + x + w + (y + h) * width, [](uint8_t cell) { return cell; })) h++;
+      for (int j = y; j < y + h; j++) std::fill(solid.begin() + x + j * width, solid.begin() + x + w + j * width, 0);
+      collision.rects.push_back({uint16_t(x), uint16_t(y), uint16_t(w), uint16_t(h)});
+    }
+  }
+
+  int cell = 1 << Collision::GRID_SHIFT;
+  collision.grid = vec2i((width + cell - 1) / cell, (height + cell - 1) / cell);
+  vector<vector<uint16_t>> cells(collision.grid.x * collision.grid.y);
+  for (int i = 0; i < collision.rects.size(); i++) {
+    const auto& rect = collision.rects[i];
+    for (int y = rect.y >> Collision::GRID_SHIFT; y <= (rect.y + rect.height - 1) >> Collision::GRID_SHIFT; y++) {
+      for (int x = rect.x >> Collision::GRID_SHIFT; x <= (rect.x + rect.width - 1) >> Collision::GRID_SHIFT; x++) cells[x + y * collision.grid.x].push_back(i);
+    }
+  }
+  for (const auto& rects : cells) {
+    collision.starts.push_back(collision.entries.size());
+    collision.entries.insert(collision.entries.end(), rects.begin(), rects.end());
+  }
+  collision.starts.push_back(collision.entries.size());
+  return collision;
+}
+
+// An offset table first, so the device finds level N without walking the others
+std::string exportColliders() {
+  vector<std::string> blocks;
+  for (const auto level : levels) {
+    Collision collision = TiledLevel::collision(level);
+    if (collision.rects.size() > UINT16_MAX || collision.entries.size() > UINT16_MAX) throw std::runtime_error("Level " + level->name + " has too many collision rectangles to export");
+    std::string block = itobytes(Collision::GRID_SHIFT, 1) + itobytes(collision.rects.size(), 2);
+    for (const auto& rect : collision.rects) block += itobytes(rect.x, 2) + itobytes(rect.y, 2) + itobytes(rect.width, 2) + itobytes(rect.height, 2);
+    block += itobytes(collision.grid.x, 2) + itobytes(collision.grid.y, 2);
+    for (uint16_t start : collision.starts) block += itobytes(start, 2);
+    for (uint16_t entry : collision.entries) block += itobytes(entry, 2);
+    blocks.push_back(block);
+  }
+
+  std::string data = "const uint8_t PROGMEM levelColliders[] = {\n  " + itobytes(levels.size(), 2);
+  size_t offset = 2 + levels.size() * 4;
+  for (const auto& block : blocks) data += itobytes(offset, 4), offset += std::count(block.begin(), block.end(), ',');
+  for (const auto& block : blocks) data += block;
+  for (int i = 0; i < 2; i++) data.pop_back();
+  data += "\n};";
+  return data;
+}
+
+vector<std::pair<Level*, uint32_t>> usages(const Textures::Atlas* tileset, vec2i tile) {
+  vector<std::pair<Level*, uint32_t>> found;
+  for (const auto level : levels) {
+    if (level->tileset == tileset && level->uses(tile)) found.push_back({level, level->uses(tile)});
+  }
+  return found;
+}
+
+// Cells are swapped on the workers, counts, the journal and the history follow on this thread
+size_t replace(const Textures::Atlas* tileset, vec2i from, vec2i to) {
+  PROFILE("TiledLevel::replace");
+  if (from == to || from == -1) return 0;
+  vector<Level*> touched;
+  for (const auto level : levels) {
+    if (level->tileset == tileset && level->uses(from)) touched.push_back(level);
+  }
+  vector<History::Cells> changed(touched.size());
+  Jobs::parallelFor(touched.size(), [&](size_t i) {
+    Level* level = touched[i];
+    vec2i* tiles = level->tiles();
+    for (int j = 0; j < level->width * level->height; j++) {
+      if (tiles[j] == from) tiles[j] = to, changed[i].add(j, from, to);
+    }
+  });
+
+  size_t cells = 0;
+  History::begin();
+  for (int i = 0; i < touched.size(); i++) {
+    Level* level = touched[i];
+    level->usage.erase(Level::usageKey(from));
+    if (to != -1) level->usage[Level::usageKey(to)] += changed[i].cells;
+    level->usageRevision++;
+    level->dirty = true;
+    level->account();
+    for (const auto& span : changed[i].spans) {
+      Journal::tiles(level, span.start, span.count, to);
+      for (uint32_t j = span.start; j < span.start + span.count; j++) level->drawMinimap(vec2i(j % level->width, j / level->width));
+    }
+    cells += changed[i].cells;
+    History::cells(level, std::move(changed[i]));
+  }
+  History::end();
+  return cells;
+}
+
+size_t fill(Level* level, vec2i pos, vec2i size, vec2i tile) {
+  PROFILE("TiledLevel::fill");
+  vec2i start = max(pos, vec2i(0)), end = min(pos + size, level->size());
+  vec2i* tiles = level->tiles();
+  History::Cells cells;
+  for (int y = start.y; y < end.y; y++) {
+    for (int x = start.x; x < end.x; x++) {
+      uint32_t i = x + y * level->width;
+      if (tiles[i] != tile) cells.add(i, tiles[i], tile);
+    }
+  }
+  History::apply(level, cells, true);
+  size_t changed = cells.cells;
+  History::cells(level, std::move(cells));
+  return changed;
+}
+
+const vector<uint8_t>& usedTiles(const Textures::Atlas* atlas) {
+  UsedTiles& cached = usedTilesCache[atlas];
+  vector<std::pair<const Level*, uint32_t>> current;
+  for (const auto level : levels) {
+    if (level->tileset == atlas) current.push_back({level, level->usageRevision});
+  }
+  int tiles = atlas->width() * atlas->height();
+  if (current == cached.levels && tiles == cached.tiles) return cached.used;
+
+  PROFILE("TiledLevel::usedTiles");
+  cached.levels = std::move(current), cached.tiles = tiles;
+  cached.used.assign(tiles, false);
+  for (const auto& [level, revision] : cached.levels) {
+    for (const auto& [key, count] : level->usage) {
+      vec2i tile(key & 0xffff, key >> 16);
+      if (inRange(tile.x, 0, atlas->width()) && inRange(tile.y, 0, atlas->height())) cached.used[atlas->toIndex(tile)] = true;
+    }
+  }
+  return cached.used;
+}
+
+vector<int> exportedTiles(const Textures::Atlas* atlas) {
+  int tiles = atlas->width() * atlas->height();
+  vector<int> indices(tiles);
+  bool tileset = std::any_of(levels.begin(), levels.end(), [&](Level* level) { return level->tileset == atlas; });
+  vector<uint8_t> used = usedTiles(atlas);
+  if (!tileset) {
+    for (int i = 0; i < tiles; i++) indices[i] = i;
+    return indices;
+  }
+
+  if (atlas->tileset) {
+    for (const auto& patch : atlas->tileset->patches) {
+      bool any = false;
+      for (int i = 0; i < 4; i++) any |= patch.x + i < atlas->width() && used[atlas->toIndex(patch + vec2i(i, 0))];
+      for (int i = 0; i < 4 && any; i++) {
+        if (patch.x + i < atlas->width()) used[atlas->toIndex(patch + vec2i(i, 0))] = true;
+      }
+    }
+  }
+  for (const auto object : Textures::objects) {
+    if (object->atlas == atlas && tiles) used[0] = true;
+  }
+  for (int i = 0, next = 0; i < tiles; i++) indices[i] = used[i] ? next++ : -1;
+  return indices;
+}
+}  // namespace TiledLevel
@@ -0,0 +1,41 @@
+#include "memory.hpp"
+#include "assets.hpp"
+
+namespace Memory {
+const char* const kindNames[KINDS] = {"Images", "Textures", "Tiles", "Colliders", "Objects", "Strings", "Viewport", "History"};
+Counter totals[KINDS], all;
+
+void refresh() {
+  for (const auto atlas : Textures::atlases) atlas->account();
+  for (const auto object : Textures::objects) object->account();
+  for (const auto level : TiledLevel::levels) level->account();
+}
+
+vector<Entry> accounts() {
+  vector<Entry> entries;
+  for (const auto atlas : Textures::atlases) entries.push_back({"Atlas", &atlas->name, &atlas->memory});
+  for (const auto object : Textures::objects) entries.push_back({"Object", &object->name, &object->memory});
+  for (const auto level : TiledLevel::levels) entries.push_back({"Level", &level->name, &level->memory});
+  std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.account->peak > b.account->peak; });
+  return entries;
+}
+
+std::string size(int64_t bytes) {
+  if (bytes < 1024) return format("%d B", int(bytes));
+  if (bytes < 1024 * 1024) return format("%.1f KB", bytes / 1024.0);
+  return format("%.1f MB", bytes / (1024.0 * 1024.0));
+}
+
+std::string report(size_t assets) {
+  refresh();
+  std::string out = format("%-12s %12s %12s\n", "Subsystem", "Current", "Peak");
+  for (int kind = 0; kind < KINDS; kind++) out += format("%-12s %12s %12s\n", kindNames[kind], size(totals[kind].bytes).c_str(), size(totals[kind].peak).c_str());
+  out += format("%-12s %12s %12s\n", "Total", size(all.bytes).c_str(), size(all.peak).c_str());
+
+  vector<Entry> rows = accounts();
+  rows.resize(std::min(rows.size(), assets));
+  out += format("\n%-6s %-32s %12s %12s\n", "Asset", "Name", "Current", "Peak");
+  for (const auto& row : rows) out += format("%-6s %-32s %12s %12s\n", row.type, row.name->c_str(), size(row.account->total()).c_str(), size(row.account->peak).c_str());
+  return out;
+}
+}  // namespace Memory
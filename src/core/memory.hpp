@@ -0,0 +1,64 @@
+#pragma once
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+
+// Bytes held per subsystem and per asset, with peaks. Every asset has an Account it updates when what it holds
+// changes, the totals are the sum of all accounts
+namespace Memory {
+enum Kind : uint8_t { IMAGES, TEXTURES, TILES, COLLIDERS, OBJECTS, STRINGS, VIEWPORT, HISTORY, KINDS };
+extern const char* const kindNames[KINDS];
+
+struct Counter {
+  std::atomic<int64_t> bytes = 0, peak = 0;
+
+  void add(int64_t delta) {
+    int64_t now = bytes += delta, old = peak;
+    while (now > old && !peak.compare_exchange_weak(old, now)) {}
+  }
+};
+
+extern Counter totals[KINDS], all;
+
+// Owned by one asset, only that asset's thread touches it
+struct Account {
+  int64_t bytes[KINDS] = {};
+  int64_t peak = 0;
+
+  Account() {}
+  Account(const Account&) = delete;
+  ~Account() {
+    for (int kind = 0; kind < KINDS; kind++) set(Kind(kind), 0);
+  }
+
+  void set(Kind kind, int64_t size) {
+    if (size == bytes[kind]) return;
+    totals[kind].add(size - bytes[kind]);
+    all.add(size - bytes[kind]);
+    bytes[kind] = size;
+    peak = std::max(peak, total());
+  }
+
+  int64_t total() const {
+    int64_t sum = 0;
+    for (int64_t size : bytes) sum += size;
+    return sum;
+  }
+};
+
+// Recounts what's cheap to count only when asked: colliders, property columns, object lists. Don't call while the
+// project is loading
+void refresh();
+struct Entry {
+  const char* type;
+  const std::string* name;
+  const Account* account;
+};
+// Every asset's account, highest peak first
+std::vector<Entry> accounts();
+std::string size(int64_t bytes);
+// Totals and the biggest assets as a text table, for the headless tools
+std::string report(size_t assets = 20);
+}  // namespace Memory
@@ -0,0 +1,161 @@
+#include "packer.hpp"
+#include <climits>
+#include <unordered_map>
+
+namespace Packer {
+static bool inside(const MaxRects::Rect& a, const MaxRects::Rect& b) { return a.x >= b.x && a.y >= b.y && a.x + a.width <= b.x + b.width && a.y + a.height <= b.y + b.height; }
+
+bool MaxRects::insert(vec2i block, vec2i& pos) {
+  int best = -1, bestShort = INT_MAX, bestLong = INT_MAX;
+  for (int i = 0; i < free.size(); i++) {
+    if (free[i].width < block.x || free[i].height < block.y) continue;
+    int shortSide = min(free[i].width - block.x, free[i].height - block.y), longSide = max(free[i].width - block.x, free[i].height - block.y);
+    if (shortSide < bestShort || shortSide == bestShort && longSide < bestLong) best = i, bestShort = shortSide, bestLong = longSide;
+  }
+  if (best == -1) return false;
+  Rect used{free[best].x, free[best].y, block.x, block.y};
+  pos = vec2i(used.x, used.y);
+
+  // Every free rect the block overlaps is replaced by what's left of it on each side, then the ones inside another go
+  vector<Rect> split;
+  for (const auto& rect : free) {
+    if (used.x >= rect.x + rect.width || used.x + used.width <= rect.x || used.y >= rect.y + rect.height || used.y + used.height <= rect.y) {
+      split.push_back(rect);
+      continue;
+    }
+    if (used.x > rect.x) split.push_back({rect.x, rect.y, used.x - rect.x, rect.height});
+    if (used.x + used.width < rect.x + rect.width) split.push_back({used.x + used.width, rect.y, rect.x + rect.width - used.x - used.width, rect.height});
+    if (used.y > rect.y) split.push_back({rect.x, rect.y, rect.width, used.y - rect.y});
+    if (used.y + used.height < rect.y + rect.height) split.push_back({rect.x, used.y + used.height, rect.width, rect.y + rect.height - used.y - used.height});
+  }
+  free.clear();
+  for (int i = 0; i < split.size(); i++) {
+    bool contained = false;
+    for (int j = 0; j < split.size() && !contained; j++) contained = i != j && inside(split[i], split[j]) && (j < i || !inside(split[j], split[i]));
+    if (!contained) free.push_back(split[i]);
+  }
+  return true;
+}
+
+struct Source {
+  std::string name;
+  std::unique_ptr<MvImage> image;
+  vec2i offset, trimmed, size;
+  std::string pixels;  // Trimmed size and RGBA, to find duplicates by
+};
+
+static void checkGrid(vec2i tilesize, int gridWidth) {
+  if (tilesize.x <= 0 || tilesize.y <= 0) throw std::runtime_error(format("Tile size %dx%d must be positive", tilesize.x, tilesize.y));
+  if (gridWidth < 1 || gridWidth > MAX_TILES) throw std::runtime_error(format("Atlases must be 1 to %d tiles wide, not %d", MAX_TILES, gridWidth));
+}
+
+Packed pack(const vector<std::string>& files, vec2i tilesize, int gridWidth) {
+  PROFILE("Packer::pack");
+  checkGrid(tilesize, gridWidth);
+  vector<Source> sources(files.size());
+  Jobs::parallelFor(files.size(), [&](size_t i) {
+    Source& source = sources[i];
+    source.name = fs::path(files[i]).stem().string();
+    source.image = std::make_unique<MvImage>(files[i]);
+    const MvImage& image = *source.image;
+    if (image.width <= 0 || image.height <= 0) throw std::runtime_error("Can't read sprite " + files[i]);
+    vec2i start(image.width, image.height), end = 0;
+    for (int y = 0; y < image.height; y++) {
+      for (int x = 0; x < image.width; x++) {
+        if (image.getPixel(x, y).a) start = min(start, vec2i(x, y)), end = max(end, vec2i(x + 1, y + 1));
+      }
+    }
+    if (end.x <= start.x) start = 0, end = 1;  // Nothing opaque, kept as a single clear pixel
+    source.offset = start, source.trimmed = end - start, source.size = vec2i(image.width, image.height);
+    source.pixels = format("%d %d ", source.trimmed.x, source.trimmed.y);
+    for (int y = start.y; y < end.y; y++) {
+      for (int x = start.x; x < end.x; x++) {
+        MvColor pixel = image.getPixel(x, y);
+        source.pixels += {char(pixel.r), char(pixel.g), char(pixel.b), char(pixel.a)};
+      }
+    }
+  });
+
+  vector<int> unique(files.size()), uniques;
+  std::unordered_map<std::string, int> seen;
+  for (int i = 0; i < sources.size(); i++) {
+    auto [it, added] = seen.emplace(std::move(sources[i].pixels), i);
+    unique[i] = it->second;
+    if (added) uniques.push_back(i);
+  }
+  seen.clear();
+
+  // Biggest first, by longer side then area, so the small ones fill the gaps they leave
+  int rows = MAX_TILES / gridWidth;
+  auto tiles = [&](int i) { return (sources[i].trimmed + tilesize - 1) / tilesize; };
+  for (int i : uniques) {
+    vec2i block = tiles(i);
+    if (block.x > gridWidth || block.y > rows) throw std::runtime_error(format("Sprite %s needs %dx%d tiles, atlases are %dx%d", sources[i].name.c_str(), block.x, block.y, gridWidth, rows));
+  }
+  std::stable_sort(uniques.begin(), uniques.end(), [&](int a, int b) {
+    vec2i blockA = tiles(a), blockB = tiles(b);
+    if (max(blockA.x, blockA.y) != max(blockB.x, blockB.y)) return max(blockA.x, blockA.y) > max(blockB.x, blockB.y);
+    return blockA.x * blockA.y > blockB.x * blockB.y;
+  });
+
+  Packed packed;
+  packed.unique = uniques.size();
+  vector<int> atlasOf(files.size());
+  vector<vec2i> placed(files.size());
+  for (vector<int> remaining = uniques; !remaining.empty();) {
+    MaxRects bin(vec2i(gridWidth, rows));
+    vector<int> here, left;
+    vec2i used = 0;
+    for (int i : remaining) {
+      if (!bin.insert(tiles(i), placed[i])) left.push_back(i);
+      else here.push_back(i), atlasOf[i] = packed.images.size(), used = max(used, placed[i] + tiles(i));
+    }
+
+    auto image = std::make_unique<MvImage>(used * tilesize, nullptr);
+    image->clear(MvColor::alpha);
+    for (int i : here) {
+      const Source& source = sources[i];
+      for (int y = 0; y < source.trimmed.y; y++) {
+        for (int x = 0; x < source.trimmed.x; x++) image->setPixel(placed[i].x * tilesize.x + x, placed[i].y * tilesize.y + y, source.image->getPixel(source.offset.x + x, source.offset.y + y));
+      }
+    }
+    packed.images.push_back(std::move(image));
+    remaining = std::move(left);
+  }
+
+  packed.sprites.resize(packed.images.size());
+  for (int i = 0; i < sources.size(); i++) {
+    int first = unique[i];
+    packed.sprites[atlasOf[first]].push_back({sources[i].name, placed[first], tiles(first), sources[i].offset, sources[i].size});
+  }
+  return packed;
+}
+
+vector<Textures::Atlas*> import(const std::string& folder, const std::string& name, vec2i tilesize, int gridWidth) {
+  checkGrid(tilesize, gridWidth);
+  vector<std::string> files;
+  for (const auto& entry : fs::directory_iterator(folder)) {
+    if (entry.path().extension() == ".png") files.push_back(entry.path().string());
+  }
+  if (files.empty()) throw std::runtime_error("No PNGs in " + folder);
+  std::sort(files.begin(), files.end());
+  Packed packed = pack(files, tilesize, gridWidth);
+
+  vector<std::string> names;
+  for (int i = 0; i < packed.images.size(); i++) {
+    names.push_back(i ? format("%s%d", name.c_str(), i) : name);
+    if (Textures::atlasNames.find(names.back())) throw std::runtime_error("There's already an atlas called " + names.back());
+  }
+  vector<Textures::Atlas*> created;
+  for (int i = 0; i < packed.images.size(); i++) {
+    auto atlas = new Textures::Atlas(std::move(packed.images[i]), tilesize);
+    atlas->name = names[i];
+    atlas->sprites = std::move(packed.sprites[i]);
+    Textures::atlases.push_back(atlas);
+    Textures::atlasNames.add(atlas);
+    created.push_back(atlas);
+  }
+  reindex(Textures::atlases);
+  return created;
+}
+}  // namespace Packer
@@ -0,0 +1,37 @@
+#pragma once
+#include "assets.hpp"
+
+// Packs loose sprite PNGs into atlases on a tile grid. Sprites are trimmed to their opaque pixels and identical ones are
+// stored once. Each takes a block of whole tiles placed by a MaxRects packer, so atlases, and the flash they end up in,
+// stay small
+namespace Packer {
+constexpr int MAX_TILES = 255;  // The flat export has a byte for an atlas's tile count
+
+// Free space of one atlas as overlapping rectangles, in tiles. Blocks go where they leave the shortest side over
+struct MaxRects {
+  struct Rect {
+    int x, y, width, height;
+  };
+  vec2i size;
+  vector<Rect> free;
+
+  MaxRects(vec2i size) : size(size), free{{0, 0, size.x, size.y}} {}
+
+  // False if the block doesn't fit anywhere
+  bool insert(vec2i block, vec2i& pos);
+};
+
+struct Packed {
+  vector<std::unique_ptr<MvImage>> images;  // One per atlas, cropped to the tiles in use
+  vector<vector<Textures::Atlas::Sprite>> sprites;  // For each atlas, every file packed into it, duplicates included
+  int unique = 0;
+};
+
+// Sprites are named by file stem. Atlases are gridWidth tiles wide and hold at most MAX_TILES. Files are decoded in
+// parallel. Throws if the tile size isn't positive, gridWidth isn't 1 to MAX_TILES or a sprite can't fit in an empty
+// atlas
+Packed pack(const vector<std::string>& files, vec2i tilesize, int gridWidth = 16);
+// Packs every PNG in folder into atlases called name, name1, ... They stay in memory until the next save writes their
+// PNG, .atl and .spr together
+vector<Textures::Atlas*> import(const std::string& folder, const std::string& name, vec2i tilesize, int gridWidth = 16);
+}  // namespace Packer
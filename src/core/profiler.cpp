@@ -0,0 +1,62 @@
+#include "profiler.hpp"
+#include "base.hpp"
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <atomic>
+
+namespace Profiler {
+bool enabled = true;
+size_t keep = 600;
+static std::deque<Frame> history;
+static Frame current = {now(), 0, {}};
+static std::mutex mutex;  // Jobs and the saver record from their own threads
+
+static uint32_t threadId() {
+  static std::atomic<uint32_t> next = 0;
+  thread_local uint32_t id = next++;
+  return id;
+}
+
+int64_t now() {
+  static const auto startup = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startup).count();
+}
+
+void record(const char* name, int64_t start, int64_t end) {
+  uint32_t thread = threadId();
+  std::lock_guard<std::mutex> lock(mutex);
+  current.events.push_back({name, start, end, thread});
+}
+
+void nextFrame() {
+  std::lock_guard<std::mutex> lock(mutex);
+  current.end = now();
+  history.push_back(std::move(current));
+  while (history.size() > keep) history.pop_front();
+  current = {history.back().end, 0, {}};
+}
+
+vector<Frame> frames(size_t count) {
+  std::lock_guard<std::mutex> lock(mutex);
+  return vector<Frame>(history.end() - min(count, history.size()), history.end());
+}
+
+bool writeTrace(const std::string& path, size_t count) {
+  vector<Frame> captured = frames(count);
+  File file(path, "wb");
+  if (!file()) return false;
+  fputs("{\"traceEvents\": [\n", file());
+  bool first = true;
+  auto event = [&](const char* name, int64_t start, int64_t end, uint32_t thread) {
+    fprintf(file(), "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 0, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}", first ? "" : ",\n", name, thread, start / 1000.0, (end - start) / 1000.0);
+    first = false;
+  };
+  for (const auto& frame : captured) {
+    event("Frame", frame.start, frame.end, threadId());
+    for (const auto& e : frame.events) event(e.name, e.start, e.end, e.thread);
+  }
+  fputs("\n], \"displayTimeUnit\": \"ms\"}\n", file());
+  return !ferror(file());
+}
+}  // namespace Profiler
@@ -0,0 +1,44 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Scoped timers for the hot paths, kept for the last few hundred frames. PROFILE("name") times the rest of the enclosing
+// block, names must be string literals. Nothing is read or stored while recording is off
+namespace Profiler {
+struct Event {
+  const char* name;
+  int64_t start, end;  // Nanoseconds since startup
+  uint32_t thread;
+};
+
+struct Frame {
+  int64_t start, end;
+  std::vector<Event> events;
+};
+
+extern bool enabled;
+extern size_t keep;  // Frames kept for the panel and captures
+
+int64_t now();
+void record(const char* name, int64_t start, int64_t end);
+// Closes the frame that's being recorded, call once per frame
+void nextFrame();
+// The last count frames, oldest first
+std::vector<Frame> frames(size_t count = SIZE_MAX);
+// Chrome trace_event JSON of the last count frames, opened by chrome://tracing or ui.perfetto.dev
+bool writeTrace(const std::string& path, size_t count);
+
+struct Scope {
+  const char* name;
+  int64_t start;
+  Scope(const char* name) : name(name), start(enabled ? now() : -1) {}
+  ~Scope() {
+    if (start >= 0) record(name, start, now());
+  }
+};
+}  // namespace Profiler
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE(name) Profiler::Scope PROFILE_CONCAT(profileScope, __LINE__)(name)
@@ -0,0 +1,14 @@
+#include "assets.hpp"
+
+std::string projectSaveDirectory;
+
+namespace Project {
+std::atomic<int> loaded = 0, toLoad = 0;
+
+void load() {
+  loaded = toLoad = 0;
+  TiledLevel::clear();  // Levels first, their objects unregister from the classes Textures::load is about to delete
+  Textures::load();
+  TiledLevel::load();
+}
+}  // namespace Project
@@ -0,0 +1,53 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// Hash lookup of assets by name. Every name gets an id the first time it's seen, ids are never reused or reordered, so
+// they can be stored where a pointer or a position in a sorted list can't
+template <typename T> struct Registry {
+  std::unordered_map<std::string, uint32_t> ids;
+  std::vector<T*> byId;
+
+  uint32_t intern(const std::string& name) {
+    auto [it, inserted] = ids.try_emplace(name, byId.size());
+    if (inserted) byId.push_back(nullptr);
+    return it->second;
+  }
+
+  // Returns false if the name was already taken by something else
+  bool add(T* item) {
+    item->id = intern(item->name);
+    bool free = !byId[item->id] || byId[item->id] == item;
+    byId[item->id] = item;
+    return free;
+  }
+
+  void remove(T* item) {
+    auto it = ids.find(item->name);
+    if (it != ids.end() && byId[it->second] == item) byId[it->second] = nullptr;
+  }
+
+  bool rename(T* item, const std::string& name) {
+    remove(item);
+    item->name = name;
+    return add(item);
+  }
+
+  T* find(const std::string& name) const {
+    auto it = ids.find(name);
+    return it == ids.end() ? nullptr : byId[it->second];
+  }
+
+  T* operator[](uint32_t id) const { return id < byId.size() ? byId[id] : nullptr; }
+
+  void clear() {
+    ids.clear();
+    byId.clear();
+  }
+};
+
+// Position in the (sorted) list, which is what exports refer to
+template <typename T> void reindex(std::vector<T*>& items) {
+  for (uint32_t i = 0; i < items.size(); i++) items[i]->index = i;
+}
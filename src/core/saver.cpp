@@ -0,0 +1,112 @@
+#include "saver.hpp"
+#include "base.hpp"
+#include "profiler.hpp"
+#include <mutex>
+#include <future>
+#include <unordered_map>
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace Saver {
+struct Result {
+  std::string failed;
+  std::vector<bool> written;
+};
+static std::future<Result> saver;
+static std::function<void(const std::string& failed)> onDone;
+static std::vector<std::function<void(bool written)>> jobsDone;
+static std::unordered_map<std::string, fs::file_time_type> written;
+static std::mutex writtenMutex;
+
+static std::string normal(const std::string& path) { return fs::path(path).lexically_normal().string(); }
+
+bool wroteLast(const std::string& path) {
+  std::error_code error;
+  auto time = fs::last_write_time(path, error);
+  std::lock_guard<std::mutex> lock(writtenMutex);
+  auto it = written.find(normal(path));
+  return !error && it != written.end() && it->second == time;
+}
+
+bool sync(FILE* file) {
+  if (fflush(file) != 0) return false;
+#ifdef _WIN32
+  return _commit(_fileno(file)) == 0;
+#else
+  return fsync(fileno(file)) == 0;
+#endif
+}
+
+static bool flush(const std::string& path) {
+  FILE* file = fopen(path.c_str(), "rb+");
+  if (!file) return false;
+  bool ok = sync(file);
+  fclose(file);
+  return ok;
+}
+
+static bool replace(const std::string& tmp, const std::string& path) {
+#ifdef _WIN32
+  return MoveFileExA(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+  return rename(tmp.c_str(), path.c_str()) == 0;
+#endif
+}
+
+void submit(std::vector<Job> jobs, const std::string& tmpFolder, std::function<void(const std::string& failed)> done) {
+  wait();
+  if (jobs.empty()) {
+    if (done) done("");
+    return;
+  }
+  onDone = std::move(done);
+  for (auto& job : jobs) jobsDone.push_back(std::move(job.done));
+  saver = std::async(std::launch::async, [jobs = std::move(jobs), tmpFolder]() -> Result {
+    std::error_code error;
+    fs::create_directories(tmpFolder, error);
+    std::string failed;
+    std::vector<bool> wrote(jobs.size());
+    for (int i = 0; i < jobs.size(); i++) {
+      std::string tmp = tmpFolder + std::to_string(i) + "." + fs::path(jobs[i].path).filename().string();
+      PROFILE("Saver::write");
+      try {
+        fs::create_directories(fs::path(jobs[i].path).parent_path());
+        jobs[i].write(tmp);
+      } catch (const std::exception& e) {
+        failed += jobs[i].path + " (" + e.what() + ") ";
+        continue;
+      }
+      if (!flush(tmp) || !replace(tmp, jobs[i].path)) {
+        failed += jobs[i].path + " ";
+        continue;
+      }
+      wrote[i] = true;
+      std::lock_guard<std::mutex> lock(writtenMutex);
+      written[normal(jobs[i].path)] = fs::last_write_time(jobs[i].path, error);
+    }
+    return {failed, wrote};
+  });
+}
+
+bool saving() { return saver.valid(); }
+
+void update() {
+  if (!saver.valid()) return;
+  if (saver.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return;
+  Result result = saver.get();
+  auto done = std::move(jobsDone);
+  jobsDone.clear();
+  for (int i = 0; i < done.size(); i++) {
+    if (done[i]) done[i](result.written[i]);
+  }
+  if (onDone) std::exchange(onDone, nullptr)(result.failed);
+}
+
+void wait() {
+  if (saver.valid()) saver.wait(), update();
+}
+}  // namespace Saver
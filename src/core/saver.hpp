@@ -0,0 +1,25 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <functional>
+
+namespace Saver {
+// Everything needed to write one file, copied on the UI thread so the saver thread never touches live assets
+struct Job {
+  std::string path;
+  std::function<void(const std::string& tmp)> write;
+  // Called from update() once the file is on disk or failed to get there, so its asset can be marked dirty again
+  std::function<void(bool written)> done = nullptr;
+};
+
+// Jobs are written to a temporary file and renamed over their target, so a crash never leaves a half-written file behind.
+// done is called from update() once everything is on disk, with the paths that couldn't be written
+void submit(std::vector<Job> jobs, const std::string& tmpFolder, std::function<void(const std::string& failed)> done = nullptr);
+bool sync(FILE* file);
+// Whether the file on disk is still the one we wrote, so file watchers can skip our own saves
+bool wroteLast(const std::string& path);
+bool saving();
+void update();
+void wait();
+}  // namespace Saver
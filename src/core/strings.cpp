@@ -0,0 +1,27 @@
+#include "strings.hpp"
+#include "memory.hpp"
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+namespace Strings {
+static std::deque<std::string> strings = {""};  // A deque so references handed out by get() survive later interns
+static std::unordered_map<std::string, uint32_t> ids = {{"", 0}};
+static std::mutex mutex;
+
+uint32_t intern(const std::string& str) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto [it, inserted] = ids.try_emplace(str, strings.size());
+  if (inserted) {
+    strings.push_back(str);
+    int64_t bytes = 2 * (sizeof(std::string) + str.capacity()) + sizeof(uint32_t);  // Kept twice, in the deque and as the map key
+    Memory::totals[Memory::STRINGS].add(bytes), Memory::all.add(bytes);
+  }
+  return it->second;
+}
+
+const std::string& get(uint32_t id) {
+  std::lock_guard<std::mutex> lock(mutex);
+  return id < strings.size() ? strings[id] : strings[0];
+}
+}  // namespace Strings
@@ -0,0 +1,9 @@
+#pragma once
+#include <string>
+#include <cstdint>
+
+// Interned strings, so string property values are stored as a 32 bit id. Thread safe, never shrinks
+namespace Strings {
+uint32_t intern(const std::string& str);
+const std::string& get(uint32_t id);
+}  // namespace Strings
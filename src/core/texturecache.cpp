@@ -0,0 +1,147 @@
+#include "texturecache.hpp"
+#include "profiler.hpp"
+#include <mutex>
+#include <unordered_map>
+
+namespace TextureCache {
+Backend* backend = nullptr;
+Stats stats;
+uint64_t releaseAfter = 300;
+static uint64_t frame = 0, frameUploads = 0, frameBytes = 0;
+
+struct Rect {
+  vec2i pos, size;
+};
+
+struct Entry {
+  uint32_t texture = 0;
+  vec2i size = 0;
+  const MvImage* image = nullptr;
+  uint32_t revision = 0;
+  uint64_t lastUse = 0;
+  vector<Rect> dirty;
+  Memory::Account* account = nullptr;
+
+  size_t bytes() const { return size.x * size.y * sizeof(MvColor); }
+};
+
+static std::unordered_map<const void*, Entry> entries;
+static vector<const void*> released;
+static std::mutex releasedMutex;
+static constexpr int MAX_RECTS = 16;  // More than that and one bounding rect is sent instead
+
+static void upload(Entry& entry, vec2i pos, vec2i size) {
+  static vector<MvColor> staging;
+  staging.resize(size.x * size.y);
+  for (int y = 0; y < size.y; y++) {
+    for (int x = 0; x < size.x; x++) staging[x + y * size.x] = entry.image->getPixel(pos.x + x, pos.y + y);
+  }
+  backend->upload(entry.texture, pos, size, staging.data());
+  frameUploads++, frameBytes += size.x * size.y * sizeof(MvColor);
+  stats.uploads++, stats.uploadedBytes += size.x * size.y * sizeof(MvColor);
+}
+
+static void destroy(Entry& entry) {
+  if (!entry.texture) return;
+  backend->destroy(entry.texture);
+  if (entry.account) entry.account->set(Memory::TEXTURES, 0);
+  stats.released++, stats.resident--, stats.residentBytes -= entry.bytes();
+  entry.texture = 0;
+}
+
+uint32_t get(const void* key, const MvImage& image, uint32_t revision, Memory::Account* account) {
+  if (!backend) return 0;
+  PROFILE("TextureCache::get");
+  Entry& entry = entries[key];
+  entry.lastUse = frame;
+  if (entry.texture && entry.size != image.size()) destroy(entry);
+
+  bool full = entry.image != &image || entry.revision != revision;
+  if (!entry.texture) {
+    entry.size = image.size();
+    entry.texture = backend->create(entry.size);
+    stats.created++, stats.resident++, stats.residentBytes += entry.bytes();
+    full = true;
+  }
+  entry.image = &image, entry.revision = revision;
+  if (full) upload(entry, 0, entry.size);
+  else {
+    for (const auto& rect : entry.dirty) upload(entry, rect.pos, rect.size);
+  }
+  entry.dirty.clear();
+
+  if (entry.account != account && entry.account) entry.account->set(Memory::TEXTURES, 0);
+  entry.account = account;
+  if (account) account->set(Memory::TEXTURES, entry.bytes());
+  return entry.texture;
+}
+
+uint32_t find(const void* key, uint32_t revision) {
+  auto it = entries.find(key);
+  if (it == entries.end() || !it->second.texture || it->second.revision != revision || !it->second.dirty.empty()) return 0;
+  it->second.lastUse = frame;
+  return it->second.texture;
+}
+
+void markDirty(const void* key, vec2i pos, vec2i size) {
+  auto it = entries.find(key);
+  if (it == entries.end() || !it->second.texture) return;  // Sent whole on the next get() anyway
+  Entry& entry = it->second;
+  vec2i end = min(pos + size, entry.size);
+  pos = max(pos, vec2i(0));
+  if (end.x <= pos.x || end.y <= pos.y) return;
+
+  // Overlapping rects are merged, so painting over the same spot doesn't pile them up
+  Rect rect{pos, end - pos};
+  for (int i = 0; i < entry.dirty.size(); i++) {
+    Rect& other = entry.dirty[i];
+    if (rect.pos.x > other.pos.x + other.size.x || other.pos.x > rect.pos.x + rect.size.x || rect.pos.y > other.pos.y + other.size.y || other.pos.y > rect.pos.y + rect.size.y) continue;
+    vec2i start = min(rect.pos, other.pos);
+    rect = {start, max(rect.pos + rect.size, other.pos + other.size) - start};
+    entry.dirty.erase(entry.dirty.begin() + i);
+    i = -1;
+  }
+  entry.dirty.push_back(rect);
+
+  if (entry.dirty.size() > MAX_RECTS) {
+    vec2i start = entry.dirty[0].pos, end = entry.dirty[0].pos + entry.dirty[0].size;
+    for (const auto& other : entry.dirty) start = min(start, other.pos), end = max(end, other.pos + other.size);
+    entry.dirty = {{start, end - start}};
+  }
+}
+
+void release(const void* key) {
+  std::lock_guard<std::mutex> lock(releasedMutex);
+  released.push_back(key);
+}
+
+void nextFrame() {
+  {
+    std::lock_guard<std::mutex> lock(releasedMutex);
+    for (const void* key : released) {
+      auto it = entries.find(key);
+      if (it == entries.end()) continue;
+      it->second.account = nullptr;  // Went away with its owner
+      destroy(it->second);
+      entries.erase(it);
+    }
+    released.clear();
+  }
+
+  // Off screen for a while, the next get() uploads it again
+  for (auto it = entries.begin(); it != entries.end();) {
+    if (it->second.lastUse + releaseAfter < frame) destroy(it->second), it = entries.erase(it);
+    else ++it;
+  }
+
+  stats.frameUploads = std::exchange(frameUploads, 0), stats.frameBytes = std::exchange(frameBytes, 0);
+  frame++;
+}
+
+void clear() {
+  for (auto& [key, entry] : entries) destroy(entry);
+  entries.clear();
+  std::lock_guard<std::mutex> lock(releasedMutex);
+  released.clear();
+}
+}  // namespace TextureCache
@@ -0,0 +1,54 @@
+#pragma once
+#include "base.hpp"
+#include "memory.hpp"
+
+// GPU copies of images, kept resident while they're shown. Only the regions marked dirty since the last upload are sent
+// again, textures nobody asked for in a while are released. The GPU side is behind Backend, so the cache runs without
+// one in the tools
+namespace TextureCache {
+struct Backend {
+  virtual ~Backend() {}
+  virtual uint32_t create(vec2i size) = 0;
+  // pixels is size.x * size.y tightly packed RGBA
+  virtual void upload(uint32_t texture, vec2i pos, vec2i size, const MvColor* pixels) = 0;
+  virtual void destroy(uint32_t texture) = 0;
+};
+
+// Hands out ids and records what would have been sent, to check upload behavior without a GPU
+struct RecordingBackend : Backend {
+  struct Upload {
+    uint32_t texture;
+    vec2i pos, size;
+  };
+  uint32_t nextId = 1;
+  vector<uint32_t> live;
+  vector<Upload> uploads;
+
+  uint32_t create(vec2i size) override { return live.push_back(nextId), nextId++; }
+  void upload(uint32_t texture, vec2i pos, vec2i size, const MvColor* pixels) override { uploads.push_back({texture, pos, size}); }
+  void destroy(uint32_t texture) override { live.erase(std::remove(live.begin(), live.end(), texture), live.end()); }
+};
+
+struct Stats {
+  uint64_t uploads = 0, uploadedBytes = 0;  // Since startup
+  uint64_t frameUploads = 0, frameBytes = 0;  // Last finished frame
+  uint64_t created = 0, released = 0;
+  size_t resident = 0, residentBytes = 0;
+};
+
+extern Backend* backend;
+extern Stats stats;
+extern uint64_t releaseAfter;  // Frames a texture may go unused before it's released
+
+// Texture for the image owned by key, uploading what changed. A new revision, image size or image object uploads it all.
+// The bytes are charged to account as TEXTURES. Main thread only
+uint32_t get(const void* key, const MvImage& image, uint32_t revision = 0, Memory::Account* account = nullptr);
+// The resident texture if it's up to date with revision, so a shown image needn't be decoded again. Counts as a use
+uint32_t find(const void* key, uint32_t revision = 0);
+// Only this region is sent by the next get()
+void markDirty(const void* key, vec2i pos, vec2i size);
+// The owner is gone, its texture is released on the next frame. Any thread
+void release(const void* key);
+void nextFrame();
+void clear();
+}  // namespace TextureCache
@@ -0,0 +1,86 @@
+#include "browser.hpp"
+#include "editor.hpp"
+
+namespace Browser {
+Folder root;
+Folder* current = &root;
+static std::string lastQuery;
+static vector<Textures::ObjectClass*> results;
+static bool stale = true;  // Classes were added since results were computed
+
+fs::path Folder::path() const { return parent ? parent->path() / name : fs::path(projectSaveDirectory + "objects"); }
+
+template <typename T> static auto bySortKey(const T& a, const std::string& key) { return a->sortKey < key; }
+
+void rebuild() {
+  root.folders.clear();
+  root.objects.clear();
+  current = &root;
+  stale = true;
+  std::error_code error;
+  for (const auto& entry : fs::recursive_directory_iterator(root.path(), error)) {
+    if (entry.is_directory()) folder(entry.path());  // Empty ones too
+  }
+  for (const auto object : Textures::objects) {
+    if (auto parent = folder(object->path.parent_path())) parent->objects.push_back(object);  // Already sorted
+  }
+}
+
+// Null if the path isn't under objects/
+Folder* folder(const fs::path& path) {
+  fs::path relative = path.lexically_normal().lexically_relative(root.path().lexically_normal());
+  if (relative.empty() || *relative.begin() == "..") return nullptr;
+  Folder* folder = &root;
+  for (const auto& part : relative) {
+    std::string name = part.string(), key = naturalKey(name);
+    if (name.empty() || name == ".") continue;
+    auto it = std::lower_bound(folder->folders.begin(), folder->folders.end(), key, bySortKey<std::unique_ptr<Folder>>);
+    if (it == folder->folders.end() || (*it)->name != name) {
+      it = folder->folders.insert(it, std::make_unique<Folder>());
+      (*it)->name = name, (*it)->sortKey = key, (*it)->parent = folder;
+    }
+    folder = it->get();
+  }
+  return folder;
+}
+
+void add(Textures::ObjectClass* object) {
+  auto parent = folder(object->path.parent_path());
+  if (!parent) return;
+  parent->objects.insert(std::upper_bound(parent->objects.begin(), parent->objects.end(), object, [](Textures::ObjectClass* a, Textures::ObjectClass* b) { return a->sortKey < b->sortKey; }), object);
+  stale = true;
+}
+
+// Case insensitive subsequence match, -1 if some character of the query is missing. Runs of consecutive characters
+// and matches at the start of a word score higher, gaps lower
+static int score(const std::string& name, const std::string& query) {
+  int total = 0, last = -2;
+  size_t at = 0;
+  for (char c : query) {
+    c = tolower((unsigned char)c);
+    while (at < name.size() && tolower((unsigned char)name[at]) != c) at++;
+    if (at == name.size()) return -1;
+    bool wordStart = at == 0 || name[at - 1] == '_' || name[at - 1] == ' ' || isupper((unsigned char)name[at]) && islower((unsigned char)name[at - 1]);
+    total += 1 + (at == last + 1) * 4 + wordStart * 2 - min<int>(at - last - 1, 3) * (last >= 0);
+    last = at++;
+  }
+  return total;
+}
+
+const vector<Textures::ObjectClass*>& search(const std::string& query) {
+  if (!stale && query == lastQuery) return results;
+
+  // Anything matching the longer query matched the shorter one too
+  vector<Textures::ObjectClass*> candidates = !stale && !lastQuery.empty() && query.compare(0, lastQuery.size(), lastQuery) == 0 ? std::move(results) : Textures::objects;
+  vector<std::pair<int, Textures::ObjectClass*>> scored;
+  for (const auto object : candidates) {
+    int points = score(object->name, query);
+    if (points >= 0) scored.push_back({points, object});
+  }
+  std::sort(scored.begin(), scored.end(), [](const auto& a, const auto& b) { return a.first != b.first ? a.first > b.first : a.second->index < b.second->index; });
+  results.clear();
+  for (const auto& [points, object] : scored) results.push_back(object);
+  lastQuery = query, stale = false;
+  return results;
+}
+}  // namespace Browser
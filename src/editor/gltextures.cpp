@@ -0,0 +1,33 @@
+#include "common.hpp"
+#include "editor.hpp"
+#include <GL/gl.h>
+
+namespace TextureCache {
+struct OpenGL : Backend {
+  uint32_t create(vec2i size) override {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size.x, size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    return texture;
+  }
+
+  void upload(uint32_t texture, vec2i pos, vec2i size, const MvColor* pixels) override {
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, pos.x, pos.y, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+  }
+
+  void destroy(uint32_t texture) override {
+    GLuint id = texture;
+    glDeleteTextures(1, &id);
+  }
+};
+
+Backend* openGL() {
+  static OpenGL backend;
+  return &backend;
+}
+}  // namespace TextureCache
@@ -0,0 +1,56 @@
+#include "common.hpp"
+#include "editor.hpp"
+
+namespace Memory {
+bool show = false;
+
+void window() {
+  if (!ImGui::Begin("Memory", &show)) return ImGui::End();
+  if (Project::loading()) {
+    ImGui::TextUnformatted("Loading...");
+    return ImGui::End();
+  }
+  refresh();
+
+  ImGui::Text("Total %s, peak %s. Pixels and tiles of cached assets count until Cache drops them (budget %s)", size(all.bytes).c_str(), size(all.peak).c_str(), size(Cache::budget).c_str());
+  if (ImGui::BeginTable("##Subsystems", KINDS + 1, ImGuiTableFlags_Borders)) {
+    ImGui::TableSetupColumn("");
+    for (const char* name : kindNames) ImGui::TableSetupColumn(name);
+    ImGui::TableHeadersRow();
+    ImGui::TableNextRow();
+    ImGui::TableNextColumn(), ImGui::TextUnformatted("Current");
+    for (const auto& counter : totals) ImGui::TableNextColumn(), ImGui::TextUnformatted(size(counter.bytes).c_str());
+    ImGui::TableNextRow();
+    ImGui::TableNextColumn(), ImGui::TextUnformatted("Peak");
+    for (const auto& counter : totals) ImGui::TableNextColumn(), ImGui::TextUnformatted(size(counter.peak).c_str());
+    ImGui::EndTable();
+  }
+  const auto& textures = TextureCache::stats;
+  ImGui::Text("%zu textures resident (%s), last frame %llu uploads (%s), %llu uploads (%s) since startup", textures.resident, size(textures.residentBytes).c_str(), (unsigned long long)textures.frameUploads, size(textures.frameBytes).c_str(), (unsigned long long)textures.uploads, size(textures.uploadedBytes).c_str());
+
+  vector<Entry> rows = accounts();  // Highest peak first, the ones to split
+
+  // Columns: type, name, one per subsystem an asset can hold, current, peak
+  const Kind kinds[] = {IMAGES, TEXTURES, TILES, COLLIDERS, OBJECTS};
+  const int columns = 2 + std::size(kinds) + 2;
+  if (ImGui::BeginTable("##Assets", columns, ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders | ImGuiTableFlags_ScrollY)) {
+    ImGui::TableSetupColumn("Type");
+    ImGui::TableSetupColumn("Name");
+    for (Kind kind : kinds) ImGui::TableSetupColumn(kindNames[kind]);
+    ImGui::TableSetupColumn("Current");
+    ImGui::TableSetupColumn("Peak");
+    ImGui::TableHeadersRow();
+    UI::list(rows.size(), -1, [&](int i) {
+      const Entry& row = rows[i];
+      ImGui::TableNextRow();
+      ImGui::TableNextColumn(), ImGui::TextUnformatted(row.type);
+      ImGui::TableNextColumn(), ImGui::TextUnformatted(row.name->c_str());
+      for (Kind kind : kinds) ImGui::TableNextColumn(), ImGui::TextUnformatted(row.account->bytes[kind] ? size(row.account->bytes[kind]).c_str() : "");
+      ImGui::TableNextColumn(), ImGui::TextUnformatted(size(row.account->total()).c_str());
+      ImGui::TableNextColumn(), ImGui::TextUnformatted(size(row.account->peak).c_str());
+    });
+    ImGui::EndTable();
+  }
+  ImGui::End();
+}
+}  // namespace Memory
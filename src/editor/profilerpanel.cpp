@@ -0,0 +1,73 @@
+#include "common.hpp"
+#include "editor.hpp"
+#include <map>
+
+namespace Profiler {
+bool show = false;
+
+struct Stats {
+  double last = 0, total = 0, max = 0;
+  int calls = 0;
+};
+
+void window() {
+  static int captureFrames = 300;
+  if (!ImGui::Begin("Profiler", &show)) return ImGui::End();
+
+  ImGui::Checkbox("Record", &enabled);
+  vector<Frame> recent = frames(240);
+  if (recent.empty()) {
+    ImGui::TextUnformatted("No frames recorded yet");
+    return ImGui::End();
+  }
+
+  // Zone times are summed per frame, so a zone hit a hundred times a frame shows its frame cost
+  vector<float> frameTimes;
+  std::map<std::string, Stats> zones;
+  for (const auto& frame : recent) {
+    frameTimes.push_back((frame.end - frame.start) / 1e6f);
+    std::map<std::string, double> inFrame;
+    for (const auto& event : frame.events) inFrame[event.name] += (event.end - event.start) / 1e6;
+    for (const auto& [name, time] : inFrame) {
+      Stats& stats = zones[name];
+      stats.total += time, stats.max = max(stats.max, time);
+      if (&frame == &recent.back()) stats.last = time;
+    }
+  }
+  for (const auto& event : recent.back().events) zones[event.name].calls++;
+
+  float average = 0, worst = 0;
+  for (float time : frameTimes) average += time / frameTimes.size(), worst = max(worst, time);
+  std::string overlay = format("%.2f ms average, %.2f ms worst", average, worst);
+  ImGui::PlotLines("##FrameTimes", frameTimes.data(), frameTimes.size(), 0, overlay.c_str(), 0, max(worst, 33.f), ImVec2(ImGui::GetContentRegionAvail().x, 80));
+
+  vector<std::pair<std::string, Stats>> sorted(zones.begin(), zones.end());
+  std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.second.total > b.second.total; });
+  if (ImGui::BeginTable("##Zones", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders | ImGuiTableFlags_ScrollY, ImVec2(0, ImGui::GetContentRegionAvail().y - ImGui::GetFrameHeightWithSpacing()))) {
+    ImGui::TableSetupColumn("Zone");
+    ImGui::TableSetupColumn("Last, ms");
+    ImGui::TableSetupColumn("Average, ms");
+    ImGui::TableSetupColumn("Worst, ms");
+    ImGui::TableSetupColumn("Calls");
+    ImGui::TableHeadersRow();
+    for (const auto& [name, stats] : sorted) {
+      ImGui::TableNextRow();
+      ImGui::TableNextColumn(), ImGui::TextUnformatted(name.c_str());
+      ImGui::TableNextColumn(), ImGui::Text("%.3f", stats.last);
+      ImGui::TableNextColumn(), ImGui::Text("%.3f", stats.total / recent.size());
+      ImGui::TableNextColumn(), ImGui::Text("%.3f", stats.max);
+      ImGui::TableNextColumn(), ImGui::Text("%d", stats.calls);
+    }
+    ImGui::EndTable();
+  }
+
+  ImGui::SetNextItemWidth(100);
+  if (ImGui::InputInt("Frames", &captureFrames)) captureFrames = std::clamp<int>(captureFrames, 1, keep);
+  ImGui::SameLine();
+  if (ImGui::Button("Save Chrome trace")) {
+    std::string path = saveFile("json");
+    if (!path.empty() && !writeTrace(path, captureFrames)) MV_ERR("Failed to write %s", path.c_str());
+  }
+  ImGui::End();
+}
+}  // namespace Profiler
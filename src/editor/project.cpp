@@ -0,0 +1,97 @@
+#include "common.hpp"
+#include "editor.hpp"
+#include "watcher.hpp"
+#include <climits>
+#include <future>
+
+namespace Project {
+static std::future<void> loader;
+
+bool loading() { return loader.valid(); }
+
+void update() {
+  if (!loader.valid()) {
+    for (const auto& path : Watcher::poll()) {
+      if (!Saver::wroteLast(path)) Textures::reload(path);
+    }
+    for (const auto& message : Textures::takeMissing()) MV_ERR("%s", message.c_str());  // Tiles that couldn't be read back
+    return;
+  }
+  if (loader.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+    status = format("Loading project: %d/%d", loaded.load(), toLoad.load());
+    return;
+  }
+  try {
+    loader.get();
+    vector<std::string> missing = Textures::takeMissing();
+    for (const auto& message : missing) MV_ERR("Missing reference: %s", message.c_str());
+    Journal::open();
+    History::clear();  // Edits the journal replayed can't be undone
+    Watcher::watch(projectSaveDirectory + "atlases/");
+    Watcher::watch(projectSaveDirectory + "objects/", true);
+  } catch (const std::exception& e) {
+    MV_ERR("Failed to load project: %s", e.what());
+  }
+}
+}  // namespace Project
+
+// Runs on a background thread, the UI only shows progress until Project::update sees it finish
+void loadProject(const std::string& folder) {
+  if (Project::loading()) return;
+  Saver::wait();  // Its jobs report back to the assets about to go
+  Journal::close();  // Whatever wasn't saved in the old project is given up on
+  Watcher::clear();
+  projectSaveDirectory = folder;
+  TiledLevel::level = nullptr, TiledLevel::object = nullptr, Textures::atlas = nullptr, Textures::object = nullptr;
+  Project::loaded = Project::toLoad = 0;
+  Project::loader = std::async(std::launch::async, [] {
+    Project::load();
+    Browser::rebuild();
+    TiledLevel::level = TiledLevel::levels.empty() ? nullptr : TiledLevel::levels[0];
+    Textures::atlas = Textures::atlases.empty() ? nullptr : Textures::atlases[0];
+
+    // Decode what the editor shows first while we're still off the UI thread
+    vector<Cache::Asset*> warmup;
+    if (TiledLevel::level) warmup.push_back(TiledLevel::level);
+    if (TiledLevel::level && TiledLevel::level->tileset) warmup.push_back(TiledLevel::level->tileset);
+    if (Textures::atlas && std::find(warmup.begin(), warmup.end(), Textures::atlas) == warmup.end()) warmup.push_back(Textures::atlas);
+    Jobs::parallelFor(warmup.size(), [&](size_t i) {
+      if (auto level = dynamic_cast<TiledLevel::Level*>(warmup[i])) level->tiles();
+      else static_cast<Textures::Atlas*>(warmup[i])->image();
+    });
+  });
+}
+
+void saveProject(const std::string& folder) {
+  if (Project::loading()) return;
+  std::string previous;  // Its journal stays until the new folder is written, a failed Save as can still recover it
+  if (!folder.empty() && folder != projectSaveDirectory) {  // Save as, everything goes to the new folder
+    previous = projectSaveDirectory;
+    Journal::close(false);
+    for (const auto atlas : Textures::atlases) atlas->dirty = true;
+    for (const auto object : Textures::objects) object->path = fs::path(folder) / fs::relative(object->path, projectSaveDirectory), object->dirty = true;
+    for (const auto level : TiledLevel::levels) level->tiles(), level->dirty = true;  // Read while the old folder is still current
+    projectSaveDirectory = folder;
+    Journal::open();
+  }
+
+  vector<Saver::Job> jobs;
+  Textures::save(jobs);
+  TiledLevel::save(jobs);
+  int covered = Journal::rotate();  // Edits made while this save is written go to the next generation
+  Saver::submit(std::move(jobs), projectSaveDirectory + ".save/", [covered, folder = projectSaveDirectory, previous](const std::string& failed) {
+    if (!failed.empty()) MV_ERR("Failed to save %s", failed.c_str());
+    else {
+      Journal::commit(folder, covered);  // Not whichever project is open by now
+      if (!previous.empty()) Journal::commit(previous, INT_MAX);
+    }
+  });
+}
+
+void exportHeader(const std::string& path) {
+  if (path.empty() || Project::loading()) return;
+  std::string header = Project::exportHeader();
+  File file(path, "wb");
+  if (!file() || fwrite(header.data(), 1, header.size(), file()) != header.size()) MV_ERR("Failed to write %s", path.c_str());
+  else status = "Exported " + path;
+}
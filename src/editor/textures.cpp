@@ -1,66 +1,182 @@
 #include "common.hpp"
 #include "editor.hpp"
+#include "core/packer.hpp"
+#include <mutex>
 
 namespace Textures {
-static bool showAtlasSettingsPopup = false;
+static bool showAtlasSettingsPopup = false, showUnused = false, replacing = false, findUsages = false;
+static vec2i replaceFrom = 0;
 bool showAtlas = false, showObjects = false, showInspector = false;
 vec2i selected = 0;
-vector<Atlas*> atlases;
-vector<ObjectClass*> objects;
 Atlas* atlas;
 ObjectClass* object;
 
-Atlas* atlasByName(const std::string& name) {
-  for (const auto atlas : atlases) {
-    if (atlas->name == name) {
-      return atlas;
-    }
-  }
-  return atlases.empty() ? nullptr : atlases[0];
+static void sortAtlases() {
+  std::sort(atlases.begin(), atlases.end(), [](Atlas* a, Atlas* b) { return strcmp(a->name, b->name); });
+  reindex(atlases);
+}
+
+static void addObject(ObjectClass* object) {
+  add(object);
+  Browser::add(object);
 }
 
-void chooseAtlas(const std::string& label, Atlas*& atlas, int tilesetness) {
+bool chooseAtlas(const std::string& label, Atlas*& atlas, int tilesetness) {
+  Atlas* old = atlas;
   if (!atlas) atlas = atlases[0];
   ImGui::TextUnformatted(label.c_str());
   ImGui::SameLine();
-  if (ImGui::BeginCombo("##AtlasInput", atlas->name.c_str())) {
-    for (const auto item : atlases) {
-      if (tilesetness != -1 && !item->tileset == tilesetness) continue;
-      if (ImGui::Selectable(item->name.c_str(), item == atlas)) atlas = item;
-      if (item == atlas) ImGui::SetItemDefaultFocus();
-    }
-    ImGui::EndCombo();
-  }
+  if (tilesetness == -1) UI::combo("##AtlasInput", atlas, atlases);
+  else UI::combo<Atlas>("##AtlasInput", atlas, atlases, [=](Atlas* item) { return !item->tileset != tilesetness; });
+  return atlas != old;
 }
 
 void importAtlas(const std::string& filename) {
   if (filename.empty()) return;
   atlas = new Atlas(filename, 16);
   atlases.push_back(atlas);
+  reindex(atlases);  // Registered under its name once the settings popup gives it one
   showAtlasSettingsPopup = true;
   selected = 0;
 }
 
+static std::string spritesFolder;
+
+void importSprites(const std::string& folder) {
+  if (!folder.empty()) spritesFolder = folder;
+}
+
 void atlasSettings() {
   showAtlasSettingsPopup = true;
   selected = 0;
 }
 
+// Pixel editing. Colors are kept to what RGB565 can show, so the atlas looks like it will on the device
+enum class PixelTool { BRUSH, COLOR_PICKER, FILL_BUCKET, LINE, RECT };
+static PixelTool pixelTool = PixelTool::BRUSH;
+static bool editingPixels = false, previewRgb565 = false, stroking = false;
+static MvColor paintColor = MvColor(0, 0, 0);
+static vec2i strokeStart = 0, lastPixel = 0;
+static std::unique_ptr<MvImage> preview;  // The atlas as RGB565, kept up to date pixel by pixel while painting
+static Memory::Account previewMemory;
+static Atlas* previewAtlas = nullptr;
+static uint32_t previewAtlasRevision = -1, previewRevision = 0;
+
+static MvColor device(MvColor color) { return rgb565(rgb565(color)); }
+
+static ImTextureID previewID(Atlas* atlas) {
+  if (!preview || previewAtlas != atlas || previewAtlasRevision != atlas->revision) {
+    MvImage& image = atlas->image();
+    preview = std::make_unique<MvImage>(atlas->imageSize, nullptr);
+    for (int y = 0; y < atlas->imageSize.y; y++) {
+      for (int x = 0; x < atlas->imageSize.x; x++) preview->setPixel(x, y, device(image.getPixel(x, y)));
+    }
+    previewAtlas = atlas, previewAtlasRevision = atlas->revision, previewRevision++;
+    previewMemory.set(Memory::VIEWPORT, atlas->imageSize.x * atlas->imageSize.y * sizeof(MvColor));
+  }
+  return imID(&preview, *preview, previewRevision, &previewMemory);
+}
+
+static void paintPixel(vec2i pos, MvColor color) {
+  atlas->paint(pos, color);
+  if (!preview || previewAtlas != atlas || !inRange(pos.x, 0, preview->width) || !inRange(pos.y, 0, preview->height)) return;
+  preview->setPixel(pos.x, pos.y, device(color));
+  TextureCache::markDirty(&preview, pos, 1);
+}
+
+template <typename F> static void line(vec2i a, vec2i b, F f) {
+  vec2i delta(abs(b.x - a.x), -abs(b.y - a.y)), step(a.x < b.x ? 1 : -1, a.y < b.y ? 1 : -1);
+  for (int error = delta.x + delta.y;;) {
+    f(a);
+    if (a == b) return;
+    int twice = error * 2;
+    if (twice >= delta.y) error += delta.y, a.x += step.x;
+    if (twice <= delta.x) error += delta.x, a.y += step.y;
+  }
+}
+
+template <typename F> static void shape(vec2i a, vec2i b, F f) {
+  if (pixelTool == PixelTool::LINE) return line(a, b, f);
+  line(a, vec2i(b.x, a.y), f), line(vec2i(b.x, a.y), b, f), line(b, vec2i(a.x, b.y), f), line(vec2i(a.x, b.y), a, f);
+}
+
+// 4-connected, and never leaves the tile it starts in
+static void fill(vec2i start) {
+  MvImage& image = atlas->image();
+  uint32_t target = image.getPixel(start.x, start.y).value;
+  if (target == paintColor.value) return;
+  vec2i tileStart = start / atlas->tilesize * atlas->tilesize;
+  vector<vec2i> stack{start};
+  while (!stack.empty()) {
+    vec2i pos = stack.back();
+    stack.pop_back();
+    if (!inRange(pos.x, tileStart.x, tileStart.x + atlas->tilesize.x) || !inRange(pos.y, tileStart.y, tileStart.y + atlas->tilesize.y) || image.getPixel(pos.x, pos.y).value != target) continue;
+    paintPixel(pos, paintColor);
+    for (vec2i step : {vec2i(1, 0), vec2i(-1, 0), vec2i(0, 1), vec2i(0, -1)}) stack.push_back(pos + step);
+  }
+}
+
+static void pixelToolbar() {
+  const std::pair<PixelTool, MvImage*> tools[] = {{PixelTool::BRUSH, &UI::Tool::brush}, {PixelTool::COLOR_PICKER, &UI::Tool::colorPicker}, {PixelTool::FILL_BUCKET, &UI::Tool::fillBucket}, {PixelTool::LINE, &UI::Tool::line}, {PixelTool::RECT, &UI::Tool::rect}};
+  for (const auto& [tool, image] : tools) {
+    ImGui::Image(imID(image, *image, 0), imVec(vec2f(ImGui::GetFrameHeight())));
+    if (ImGui::IsItemClicked()) pixelTool = tool, stroking = false;
+    if (tool == pixelTool) ImGui::GetWindowDrawList()->AddRect(ImGui::GetItemRectMin(), ImGui::GetItemRectMax(), MvColor::red.value, 0.f, 0, 2.f);
+    ImGui::SameLine();
+  }
+  float color[4] = {paintColor.r / 255.f, paintColor.g / 255.f, paintColor.b / 255.f, paintColor.a / 255.f};
+  if (ImGui::ColorEdit4("##PaintColor", color, ImGuiColorEditFlags_NoInputs | ImGuiColorEditFlags_AlphaBar)) {
+    paintColor = device(MvColor(color[0] * 255 + .5f, color[1] * 255 + .5f, color[2] * 255 + .5f, color[3] * 255 + .5f));
+  }
+  ImGui::SameLine();
+  ImGui::Checkbox("Preview RGB565", &previewRgb565);
+}
+
+// A stroke ends when the button is let go, that's when the tile colors and minimaps catch up
+static void editPixels(vec2i pixel, bool hovered, vec2i viewportPos, float scale) {
+  pixel = max(min(pixel, atlas->imageSize - 1), vec2i(0));
+  if (hovered) ImGui::SetTooltip("Pixel %d, %d: #%04x", pixel.x, pixel.y, rgb565(atlas->image().getPixel(pixel.x, pixel.y)));
+  if (hovered && Mova::isMouseButtonPressed(MOUSE_LEFT)) {
+    stroking = true, strokeStart = lastPixel = pixel;
+    if (pixelTool == PixelTool::COLOR_PICKER) paintColor = device(atlas->image().getPixel(pixel.x, pixel.y));
+    if (pixelTool == PixelTool::FILL_BUCKET) fill(pixel);
+  }
+  if (!stroking) return;
+  if (Mova::isKeyPressed(MvKey::Escape)) {
+    stroking = false;
+    return commitEdits(atlas);
+  }
+  bool done = !Mova::isMouseButtonHeld(MOUSE_LEFT);
+  if (pixelTool == PixelTool::BRUSH) line(lastPixel, pixel, [](vec2i pos) { paintPixel(pos, paintColor); });
+  if (pixelTool == PixelTool::LINE || pixelTool == PixelTool::RECT) {
+    if (done) shape(strokeStart, pixel, [](vec2i pos) { paintPixel(pos, paintColor); });
+    else {
+      shape(strokeStart, pixel, [&](vec2i pos) {
+        vec2f start = viewportPos + pos * scale;
+        ImGui::GetWindowDrawList()->AddRectFilled(imVec(start), imVec(start + vec2f(scale)), device(paintColor).value);
+      });
+    }
+  }
+  lastPixel = pixel;
+  if (done) stroking = false, commitEdits(atlas);
+}
+
 static void atlasWindow() {
+  PROFILE("Textures::atlasWindow");
   if (!ImGui::Begin("Texture Atlas", &showAtlas)) return ImGui::End();
 
   if (atlas) {
-    if (ImGui::BeginCombo("##AtlasSelector", atlas->name.c_str())) {
-      for (int i = 0; i < atlases.size(); i++) {
-        if (ImGui::Selectable(atlases[i]->name.c_str(), atlases[i] == atlas)) atlas = atlases[i];
-        if (atlases[i] == atlas) ImGui::SetItemDefaultFocus();
-      }
-      ImGui::EndCombo();
+    UI::combo("##AtlasSelector", atlas, atlases);
+
+    ImGui::Checkbox("Edit pixels", &editingPixels);
+    if (editingPixels) {
+      ImGui::SameLine();
+      pixelToolbar();
     }
 
     vec2i viewportPos = oreVec(ImGui::GetCursorScreenPos());
-    float scale = min(ImGui::GetContentRegionAvail().x / atlas->image.width, ImGui::GetContentRegionAvail().y / atlas->image.height);
-    ImGui::Image(imID(atlas->image), imVec(atlas->image.size() * scale));
+    float scale = min(ImGui::GetContentRegionAvail().x / atlas->imageSize.x, ImGui::GetContentRegionAvail().y / atlas->imageSize.y);
+    ImGui::Image(editingPixels && previewRgb565 ? previewID(atlas) : imID(atlas), imVec(atlas->imageSize * scale));
     if (atlas->tileset) {
       for (auto& patch : atlas->tileset->patches) {
         vec2i start = viewportPos + patch * atlas->tilesize * scale;
@@ -74,43 +190,85 @@ static void atlasWindow() {
         }
       }
     }
+    if (showUnused) {
+      const auto& used = TiledLevel::usedTiles(atlas);
+      for (int y = 0; y < atlas->height(); y++) {
+        for (int x = 0; x < atlas->width(); x++) {
+          if (used[atlas->toIndex(vec2i(x, y))]) continue;
+          vec2i start = viewportPos + vec2i(x, y) * atlas->tilesize * scale;
+          ImGui::GetWindowDrawList()->AddRectFilled(imVec(start), imVec(start + atlas->tilesize * scale), MvColor(0, 0, 0, 160).value);
+        }
+      }
+    }
 
     vec2i tileOnMouse = (vec2f)(oreVec(ImGui::GetMousePos()) - viewportPos) / atlas->tilesize / scale;
-    if (ImGui::IsItemHovered() && (Mova::isMouseButtonHeld(MOUSE_LEFT) || Mova::isMouseButtonHeld(MOUSE_RIGHT))) {
+    if (editingPixels) editPixels((oreVec(ImGui::GetMousePos()) - viewportPos) / scale, ImGui::IsItemHovered(), viewportPos, scale);
+    else if (ImGui::IsItemHovered()) {
+      uint32_t cells = 0;
+      auto found = TiledLevel::usages(atlas, tileOnMouse);
+      for (const auto& [level, count] : found) cells += count;
+      ImGui::SetTooltip("Tile %d, %d: %u cells in %d levels", tileOnMouse.x, tileOnMouse.y, cells, (int)found.size());
+    }
+    if (!editingPixels && ImGui::IsItemHovered() && (Mova::isMouseButtonHeld(MOUSE_LEFT) || Mova::isMouseButtonHeld(MOUSE_RIGHT))) {
       if (atlas->tileset && atlas->tileset->colliders) {
         if (Mova::isKeyHeld(MvKey::Ctrl)) {
-          atlas->tileset->colliders[atlas->toIndex(tileOnMouse)] = Mova::isMouseButtonHeld(MOUSE_LEFT);
+          bool& collider = atlas->tileset->colliders[atlas->toIndex(tileOnMouse)];
+          if (collider != Mova::isMouseButtonHeld(MOUSE_LEFT)) {
+            collider = Mova::isMouseButtonHeld(MOUSE_LEFT);
+            atlas->dirty = true;
+            Journal::collider(atlas, atlas->toIndex(tileOnMouse), collider);
+            History::collider(atlas, atlas->toIndex(tileOnMouse), collider);
+          }
         }
       }
     }
 
-    if (ImGui::IsItemClicked() || ImGui::IsItemHovered() && Mova::isMouseButtonPressed(MOUSE_RIGHT)) {
+    if ((!editingPixels && ImGui::IsItemClicked()) || ImGui::IsItemHovered() && Mova::isMouseButtonPressed(MOUSE_RIGHT)) {
       selected = tileOnMouse;
       if (atlas->tileset) {
         if (atlas->tileset->inPatch(selected)) selected = atlas->tileset->patch(selected);
       }
       object = nullptr;
+      if (replacing && ImGui::IsItemClicked()) {
+        size_t cells = TiledLevel::replace(atlas, replaceFrom, selected);
+        status = format("Replaced %d cells", (int)cells);
+        replacing = false;
+      }
     }
+    if (replacing) status = format("Click the tile to replace %d, %d with in every level, Escape to cancel", replaceFrom.x, replaceFrom.y);
+    if (replacing && Mova::isKeyPressed(MvKey::Escape)) replacing = false;
     if (!Mova::isKeyHeld(MvKey::Ctrl) && ImGui::BeginPopupContextWindow()) {
       if (!atlas->tileset) {
-        if (ImGui::MenuItem("Enable tileset")) atlas->tileset = new Atlas::Tileset();
+        if (ImGui::MenuItem("Enable tileset")) History::tileset(atlas), atlas->tileset = new Atlas::Tileset(), atlas->dirty = true, Journal::tileset(atlas);
       } else {
-        if (ImGui::MenuItem("Disable tileset")) delete atlas->tileset, atlas->tileset = nullptr;
+        if (ImGui::MenuItem("Disable tileset")) History::tileset(atlas), delete[] atlas->tileset->colliders, delete atlas->tileset, atlas->tileset = nullptr, atlas->dirty = true, Journal::tileset(atlas);
       }
       if (atlas->tileset) {
         if (!atlas->tileset->inPatch(selected)) {
-          if (ImGui::MenuItem("Add patch")) atlas->tileset->patches.push_back(selected);
+          if (ImGui::MenuItem("Add patch")) atlas->tileset->patches.push_back(selected), atlas->dirty = true, Journal::patch(atlas, selected, true), History::patch(atlas, selected, true);
         } else {
-          if (ImGui::MenuItem("Remove patch")) atlas->tileset->removePatch(selected);
+          if (ImGui::MenuItem("Remove patch")) atlas->tileset->removePatch(selected), atlas->dirty = true, Journal::patch(atlas, selected, false), History::patch(atlas, selected, false);
         }
+        if (ImGui::MenuItem("Find usages")) findUsages = true;
+        if (ImGui::MenuItem("Replace everywhere...")) replacing = true, replaceFrom = selected;
+        ImGui::MenuItem("Show unused tiles", nullptr, &showUnused);
         if (!atlas->tileset->colliders) {
-          if (ImGui::MenuItem("Enable colliders")) atlas->tileset->colliders = new bool[atlas->width() * atlas->height()], memset(atlas->tileset->colliders, 0, atlas->width() * atlas->height());
+          if (ImGui::MenuItem("Enable colliders")) History::tileset(atlas), atlas->tileset->colliders = new bool[atlas->width() * atlas->height()], memset(atlas->tileset->colliders, 0, atlas->width() * atlas->height()), atlas->dirty = true, Journal::tileset(atlas);
         } else {
-          if (ImGui::MenuItem("Disable colliders")) delete[] atlas->tileset->colliders, atlas->tileset->colliders = nullptr;
+          if (ImGui::MenuItem("Disable colliders")) History::tileset(atlas), delete[] atlas->tileset->colliders, atlas->tileset->colliders = nullptr, atlas->dirty = true, Journal::tileset(atlas);
         }
       }
       ImGui::EndPopup();
     }
+    if (findUsages) ImGui::OpenPopup("Tile usages"), findUsages = false;
+    if (ImGui::BeginPopup("Tile usages")) {
+      auto found = TiledLevel::usages(atlas, selected);
+      if (found.empty()) ImGui::TextUnformatted("No level uses this tile");
+      for (const auto& [level, count] : found) {
+        if (ImGui::Selectable(format("%s: %u cells", level->name.c_str(), count).c_str())) TiledLevel::level = level, TiledLevel::object = nullptr, TiledLevel::showEditor = true;
+      }
+      ImGui::EndPopup();
+    }
     {
       vec2i start = viewportPos + selected * atlas->tilesize * scale;
       ImGui::GetWindowDrawList()->AddRect(imVec(start), imVec(start + atlas->tilesize * scale), MvColor::red.value, 0.f, 0, 3.f);
@@ -120,9 +278,9 @@ static void atlasWindow() {
 }
 
 static void objectsWindow() {
-  static fs::path base;
-  static fs::path path;
+  PROFILE("Textures::objectsWindow");
   static char tmpFolder[256];
+  static char query[256];
   static bool creatingFolder = false;
 
   if (!ImGui::Begin("Objects", &showObjects)) return ImGui::End();
@@ -131,17 +289,27 @@ static void objectsWindow() {
     return ImGui::End();
   }
 
-  if (base.empty()) path = base = projectSaveDirectory + "objects";
-  if (path != base) {
-    if (ImGui::Button("..")) path = path.parent_path();
-  }
-  for (const auto& p : fs::directory_iterator(path)) {
-    if (!p.is_directory()) continue;
-    if (ImGui::Button(p.path().stem().string().c_str())) path = p.path();
-  }
-  for (const auto& obj : objects) {
-    if (fs::path(obj->path).parent_path() != path) continue;
-    if (ImGui::Button(obj->name.c_str())) object = obj, TiledLevel::object = nullptr;
+  ImGui::SetNextItemWidth(ImGui::GetContentRegionAvail().x);
+  ImGui::InputTextWithHint("##ObjectSearch", "Search", query, sizeof(query));
+  if (query[0]) {
+    const auto& found = Browser::search(query);
+    UI::list(found.size(), -1, [&](int i) {
+      if (ImGui::Button(found[i]->name.c_str())) object = found[i], TiledLevel::object = nullptr;
+    });
+  } else {
+    // "..", then folders, then classes
+    Browser::Folder* folder = Browser::current;
+    int up = folder->parent != nullptr, folders = folder->folders.size();
+    UI::list(up + folders + folder->objects.size(), -1, [&](int i) {
+      if (i < up) {
+        if (ImGui::Button("..")) Browser::current = folder->parent;
+      } else if (i < up + folders) {
+        if (ImGui::Button(folder->folders[i - up]->name.c_str())) Browser::current = folder->folders[i - up].get();
+      } else {
+        auto obj = folder->objects[i - up - folders];
+        if (ImGui::Button(obj->name.c_str())) object = obj, TiledLevel::object = nullptr;
+      }
+    });
   }
 
   if (ImGui::BeginPopupModal("Create Object", nullptr, ImGuiWindowFlags_AlwaysAutoResize)) {
@@ -149,20 +317,13 @@ static void objectsWindow() {
     static char name[256];
     chooseAtlas("Atlas: ", atlas, 0);
     UI::formField("Object name: ", name, sizeof(name));
+    ImGui::BeginDisabled(name[0] == '\0' || objectNames.find(name));
     if (ImGui::Button("Ok")) {
-      object = new ObjectClass(name, (path / (std::string(name) + ".obj")).string(), atlas);
-      object->save();
-      uint32_t index = 0;
-      for (int i = 0; i < objects.size(); i++) {
-        if (fs::absolute(objects[i]->path).string().compare(fs::absolute(object->path.string()).string()) >= 0) {
-          index = i;
-          break;
-        }
-      }
-      objects.insert(objects.begin() + index, object);
-      std::sort(objects.begin(), objects.end(), [](ObjectClass* a, ObjectClass* b) { return strcmp(a->name, b->name); });
+      object = new ObjectClass(name, (Browser::current->path() / (std::string(name) + ".obj")).string(), atlas);
+      addObject(object);
       ImGui::CloseCurrentPopup();
     }
+    ImGui::EndDisabled();
     ImGui::SameLine();
     if (ImGui::Button("Cancel")) ImGui::CloseCurrentPopup();
     ImGui::EndPopup();
@@ -170,7 +331,8 @@ static void objectsWindow() {
 
   if (creatingFolder) {
     if (ImGui::InputText("##Filename Input", tmpFolder, sizeof(tmpFolder), ImGuiInputTextFlags_EnterReturnsTrue)) {
-      fs::create_directory(path / tmpFolder);
+      fs::create_directory(Browser::current->path() / tmpFolder);
+      Browser::folder(Browser::current->path() / tmpFolder);
       creatingFolder = false;
     }
   }
@@ -183,28 +345,30 @@ static void objectsWindow() {
 }
 
 static void inspectorWindow() {
+  PROFILE("Textures::inspectorWindow");
   if (!ImGui::Begin("Inspector", &showInspector)) return ImGui::End();
   if (object && !TiledLevel::object) {
     ImGui::TextUnformatted("Object Class");
     ImGui::TextUnformatted(object->name.c_str());
-    chooseAtlas("Atlas: ", object->atlas, 0);
+    if (chooseAtlas("Atlas: ", object->atlas, 0)) object->dirty = true;
     ImGui::Separator();
 
     ImGui::TextUnformatted("Object Properties:");
-    int propertyToMove = -1, direction = 0;
-    for (int i = 0; i < object->properties.size(); i++) {
+    int propertyToMove = -1, direction = 0, propertyToRemove = -1;
+    float width = (ImGui::GetContentRegionAvail().x - ImGui::CalcTextSize("-").x - 10 - ImGui::GetStyle().FramePadding.x * 10) / 5;
+    UI::list(object->properties.size(), -1, [&](int i) {
       char buffer[256];
       strcpy(buffer, object->properties[i].name.c_str());
-      float width = (ImGui::GetContentRegionAvail().x - ImGui::CalcTextSize("-").x - 10 - ImGui::GetStyle().FramePadding.x * 10) / 5;
       ImGui::SetNextItemWidth(width * 2);
-      if (ImGui::InputTextEx(("##PropertyNameInput" + std::to_string(i)).c_str(), "Property name", buffer, sizeof(buffer), imVec(vec2i(0)), 0)) {
+      if (ImGui::InputTextEx("##PropertyNameInput", "Property name", buffer, sizeof(buffer), imVec(vec2i(0)), 0)) {
         object->properties[i].name = buffer;
+        object->dirty = true;
       }
       ImGui::SameLine();
       ImGui::SetNextItemWidth(width * 2);
-      if (ImGui::BeginCombo(("##PropertyType" + std::to_string(i)).c_str(), propertyTypes[(int)object->properties[i].type].c_str())) {
+      if (ImGui::BeginCombo("##PropertyType", propertyTypes[(int)object->properties[i].type].c_str())) {
         for (int j = 0; j < IM_ARRAYSIZE(propertyTypes); j++) {
-          if (ImGui::Selectable(propertyTypes[j].c_str(), j == (int)object->properties[i].type)) object->properties[i].type = (PropertyType)j;
+          if (ImGui::Selectable(propertyTypes[j].c_str(), j == (int)object->properties[i].type)) object->setType(i, (PropertyType)j), object->dirty = true, TiledLevel::markDirty(object);
           if (j == (int)object->properties[i].type) ImGui::SetItemDefaultFocus();
         }
         ImGui::EndCombo();
@@ -212,14 +376,12 @@ static void inspectorWindow() {
       ImGui::SameLine();
       ImGui::SetNextItemWidth(width);
       strcpy(buffer, object->properties[i].defaultValue.c_str());
-      if (ImGui::InputTextEx(("##PropertyDefaultValueInput" + std::to_string(i)).c_str(), "Default value", buffer, sizeof(buffer), imVec(vec2i(0)), 0)) {
+      if (ImGui::InputTextEx("##PropertyDefaultValueInput", "Default value", buffer, sizeof(buffer), imVec(vec2i(0)), 0)) {
         object->properties[i].defaultValue = buffer;
+        object->dirty = true;
       }
       ImGui::SameLine();
-      if (ImGui::Button("-")) {
-        object->properties.erase(object->properties.begin() + i);
-        for (auto child : object->children) child->properties.erase(child->properties.begin() + i);
-      }
+      if (ImGui::Button("-")) propertyToRemove = i;
       ImGui::SameLine();
       vec2i widgetPos = oreVec(ImGui::GetCursorScreenPos()) + oreVec(ImGui::GetStyle().FramePadding);
       int arrowHeight = ImGui::GetTextLineHeight() / 2 - 1;
@@ -229,14 +391,21 @@ static void inspectorWindow() {
       ImGui::GetWindowDrawList()->AddTriangleFilled(imVec(widgetPos + vec2i(0, 0)), imVec(widgetPos + vec2i(10, 0)), imVec(widgetPos + vec2i(5, arrowHeight)), MvColor::white.value);
       if (inRangeW(window->getMousePos(), widgetPos, vec2i(10, arrowHeight)) && Mova::isMouseButtonPressed(MOUSE_LEFT)) propertyToMove = i, direction = 1;
       ImGui::NewLine();
+    });
+    if (propertyToRemove != -1) {
+      object->properties.erase(object->properties.begin() + propertyToRemove);
+      object->dirty = true;
+      TiledLevel::markDirty(object);
     }
     if (ImGui::Button("+")) {
-      object->properties.emplace_back();
-      for (auto child : object->children) child->properties.emplace_back();
+      object->addProperty();
+      object->dirty = true;
+      TiledLevel::markDirty(object);
     }
     if (propertyToMove != -1 && inRange<int>(propertyToMove + direction, 0, object->properties.size())) {
-      std::iter_swap(object->properties.begin() + propertyToMove, object->properties.begin() + propertyToMove + direction);
-      for (auto child : object->children) std::iter_swap(child->properties.begin() + propertyToMove, child->properties.begin() + propertyToMove + direction);
+      std::iter_swap(object->properties.begin() + propertyToMove, object->properties.begin() + propertyToMove + direction);  // Swaps the columns too
+      object->dirty = true;
+      TiledLevel::markDirty(object);
     }
   } else if (TiledLevel::object) {
     ImGui::TextUnformatted("Object");
@@ -245,88 +414,66 @@ static void inspectorWindow() {
     if (ImGui::Button("Select")) return object = TiledLevel::object->parent, TiledLevel::object = nullptr, ImGui::End();
     ImGui::Separator();
     ImGui::TextUnformatted("Object Properties:");
-    for (int i = 0; i < TiledLevel::object->properties.size(); i++) {
-      ImGui::Text("%s: ", TiledLevel::object->parent->properties[i].name.c_str());
+    UI::list(TiledLevel::object->parent->properties.size(), -1, [&](int i) {
+      const auto& property = TiledLevel::object->parent->properties[i];
+      ImGui::Text("%s: ", property.name.c_str());
       ImGui::SameLine();
 
-      char buffer[256];
-      strcpy(buffer, TiledLevel::object->properties[i].c_str());
+      Value& value = TiledLevel::object->property(i);
+      Value before = value;
+      const char* label = "##PropertyValueInput";
+      bool edited = false;
       ImGui::SetNextItemWidth(ImGui::GetContentRegionAvail().x - ImGui::GetStyle().FramePadding.x * 2);
-      if (ImGui::InputTextEx(("##PropertyValueInput" + std::to_string(i)).c_str(), "Property Value", buffer, sizeof(buffer), imVec(vec2i(0)), 0)) {
-        TiledLevel::object->properties[i] = buffer;
+      if (property.type == PropertyType::INT) edited = ImGui::InputInt(label, &value.i);
+      else if (property.type == PropertyType::FLOAT) edited = ImGui::InputFloat(label, &value.f);
+      else {
+        char buffer[256];
+        strncpy(buffer, Strings::get(value.s).c_str(), sizeof(buffer) - 1);
+        buffer[sizeof(buffer) - 1] = '\0';
+        if (ImGui::InputTextEx(label, "Property Value", buffer, sizeof(buffer), imVec(vec2i(0)), 0)) value.s = Strings::intern(buffer), edited = true;
       }
-    }
+      if (edited) {
+        TiledLevel::level->dirty = true;
+        Journal::property(TiledLevel::level, TiledLevel::object - &TiledLevel::level->objects[0], i, formatValue(property.type, value));
+        History::property(TiledLevel::level, TiledLevel::object - &TiledLevel::level->objects[0], i, before);
+      }
+    });
   }
   ImGui::End();
 }
 
-void save() {
-  for (const auto atlas : atlases) atlas->save();
-  for (const auto object : objects) object->save();
-}
-
-void load() {
-  {  // Atlases
-    for (const auto atlas : atlases) delete atlas;
-    atlases.clear();
-    for (const auto& entry : fs::directory_iterator(projectSaveDirectory + "atlases/")) {
-      if (entry.path().extension() == ".png") atlases.push_back(new Atlas(entry.path().stem().string()));
-    }
-    std::sort(atlases.begin(), atlases.end(), [](Atlas* a, Atlas* b) { return strcmp(a->name, b->name); });
-    atlas = atlases.empty() ? nullptr : atlases[0];
-  }
-
-  {  // Objects
-    for (const auto object : objects) delete object;
-    objects.clear();
-    for (const auto& p : fs::recursive_directory_iterator(projectSaveDirectory + "objects/")) {
-      if (p.is_directory()) continue;
-      objects.push_back(new ObjectClass(p.path().string()));
-    }
-  }
-}
-
-void exportData() {
-  std::string data = "const uint8_t PROGMEM textures[] = {\n  ";
-
-  data += itobytes(atlases.size(), 2);
-  for (auto atlas : atlases) {
-    int nTiles = atlas->width() * atlas->height();
-    data += format("%d, %d, %d, ", nTiles, atlas->tilesize.x, atlas->tilesize.y);
-    for (int i = 0; i < nTiles; i++) {
-      for (int y = 0; y < atlas->tilesize.y; y++) {
-        for (int x = 0; x < atlas->tilesize.x; x++) {
-          uint16_t pixel = rgb565(atlas->image.getPixel(i * atlas->tilesize.x % atlas->image.width + x, i * atlas->tilesize.x / atlas->image.width * atlas->tilesize.y + y));
-          data += format("%d, %d, ", pixel >> 8, pixel & 0xff);
-        }
+// Called with files the watcher saw change, only what changed is read again. A file that's gone or still being written
+// is skipped, the watcher sees it again once it's done
+void reload(const std::string& path) {
+  fs::path file(path);
+  try {
+    if (file.extension() == ".png" && file.parent_path().filename() == "atlases") {
+      for (const auto atlas : atlases) {
+        if (atlas->name == file.stem().string() && atlas->source == Atlas::pngPath(atlas->name) && !atlas->edited) atlas->reload();  // Our unsaved paint wins
       }
-    }
-    data += format("%d, ", atlas->tileset != nullptr);
-    if (atlas->tileset) {
-      data += format("%d, ", atlas->tileset->patches.size());
-      for (const auto& patch : atlas->tileset->patches) {
-        data += format("%d, ", patch.x + patch.y * atlas->width() + 1);
-      }
-      data += format("%d, ", atlas->tileset->colliders != nullptr);
-      if (atlas->tileset->colliders) {
-        int tilesTotal = atlas->width() * atlas->height();
-        for (int i = 0; i < tilesTotal / 8 + (tilesTotal % 8 != 0); i++) {
-          uint8_t byte = 0;
-          for (int j = 0; j < 8; j++) {
-            if (i * 8 + j < tilesTotal) byte |= atlas->tileset->colliders[i * 8 + j] << j;
-          }
-          data += format("%d, ", byte);
-        }
+    } else if (file.extension() == ".obj") {
+      std::error_code error;
+      for (const auto object : objects) {
+        if (!fs::equivalent(object->path, file, error)) continue;
+        if (object->dirty) return;  // Our unsaved edits win
+        auto names = [&] {
+          vector<std::string> names;
+          for (const auto& property : object->properties) names.push_back(property.name);
+          return names;
+        };
+        vector<std::string> before = names();
+        object->read();
+        if (names() != before) History::clear();  // Its property edits are kept by index
+        TiledLevel::markDirty(object);
+        return;
       }
+      addObject(new ObjectClass(path));
+    } else if (fs::is_directory(file)) {
+      Browser::folder(file);  // Null, so ignored, outside objects/
     }
+  } catch (const std::exception& e) {
+    MV_ERR("Failed to reload %s: %s", path.c_str(), e.what());
   }
-  data += itobytes(objects.size(), 2);
-  for (const auto object : objects) {
-    data += itobytes(std::find(atlases.begin(), atlases.end(), object->atlas) - atlases.begin(), 2);
-  }
-  for (int i = 0; i < 2; i++) data.pop_back();
-  data += "\n};";
-  Mova::copyToClipboard(data);
 }
 
 void windows() {
@@ -336,10 +483,42 @@ void windows() {
     if (buffer[0] == '\1') strncpy(buffer, atlas->name.c_str(), sizeof(buffer) - 1);
     atlas->tilesize = max(atlas->tilesize, vec2(1));
     UI::formField("Atlas name: ", buffer, sizeof(buffer));
-    UI::formField("Tile size: ", atlas->tilesize);
-    vec2i tileCount = atlas->image.size() / atlas->tilesize;
-    if (UI::formField("Tile count: ", tileCount)) atlas->tilesize = atlas->image.size() / tileCount;
-    if (ImGui::Button("Ok")) atlas->name = buffer, buffer[0] = '\1', std::sort(atlases.begin(), atlases.end(), [](Atlas* a, Atlas* b) { return strcmp(a->name, b->name); }), ImGui::CloseCurrentPopup();
+    if (UI::formField("Tile size: ", atlas->tilesize)) atlas->dirty = true;
+    vec2i tileCount = atlas->imageSize / atlas->tilesize;
+    if (UI::formField("Tile count: ", tileCount)) atlas->tilesize = atlas->imageSize / tileCount, atlas->dirty = true;
+    ImGui::BeginDisabled(buffer[0] == '\0' || atlasNames.find(buffer) && atlasNames.find(buffer) != atlas);
+    if (ImGui::Button("Ok")) atlasNames.rename(atlas, buffer), buffer[0] = '\1', atlas->dirty = true, TiledLevel::markDirty(atlas), sortAtlases(), ImGui::CloseCurrentPopup();
+    ImGui::EndDisabled();
+    ImGui::EndPopup();
+  }
+
+  if (!spritesFolder.empty()) ImGui::OpenPopup("Import sprites");
+  if (ImGui::BeginPopupModal("Import sprites", nullptr, ImGuiWindowFlags_AlwaysAutoResize)) {
+    static char name[256] = "sprites";
+    static vec2i tilesize = 16;
+    static int grid = 16;
+    ImGui::TextUnformatted(spritesFolder.c_str());
+    UI::formField("Atlas name: ", name, sizeof(name));
+    UI::formField("Tile size: ", tilesize);
+    ImGui::TextUnformatted("Atlas width in tiles: ");
+    ImGui::SameLine();
+    ImGui::InputInt("##ImportGrid", &grid);
+    tilesize = max(tilesize, vec2i(1)), grid = std::clamp(grid, 1, Packer::MAX_TILES);
+    ImGui::BeginDisabled(name[0] == '\0' || atlasNames.find(name));
+    if (ImGui::Button("Ok")) {
+      try {
+        auto created = Packer::import(spritesFolder, name, tilesize, grid);
+        atlas = created[0], selected = 0;
+        sortAtlases();
+      } catch (const std::exception& e) {
+        MV_ERR("Failed to import sprites: %s", e.what());
+      }
+      spritesFolder.clear();
+      ImGui::CloseCurrentPopup();
+    }
+    ImGui::EndDisabled();
+    ImGui::SameLine();
+    if (ImGui::Button("Cancel")) spritesFolder.clear(), ImGui::CloseCurrentPopup();
     ImGui::EndPopup();
   }
 
@@ -4,84 +4,135 @@
 namespace TiledLevel {
 static bool showLevelSettingsPopup = false;
 bool showEditor = false;
-vector<Level*> levels;
 Level* level;
 Object* object;
 
-void newLevel() { level = nullptr, showLevelSettingsPopup = true; }
+void newLevel() { level = nullptr, object = nullptr, showLevelSettingsPopup = true; }
 void levelSettings() { showLevelSettingsPopup = true; }
 
-static bool concatX(vec2i tile, vec2i pos, int dir) { return inRange(pos.x + dir, 0, (int)level->width) && level->getTile(pos + vec2i(dir, 0)) == level->tileset->tileset->patch(tile); }
-static bool concatY(vec2i tile, vec2i pos, int dir) { return inRange(pos.y + dir, 0, (int)level->height) && level->getTile(pos + vec2i(0, dir)) == level->tileset->tileset->patch(tile); }
-
-static void drawQuater(MvDrawTarget& viewport, vec2i pos, vec2i tile, vec2f screen, vec2f tileScreenSize, vec2i quater) {
-  vec2i delta = quater * 2 - 1;
-  if (!concatX(tile, pos, delta.x)) tile.x += concatY(tile, pos, delta.y) ? 3 : 1;
-  else if (!concatY(tile, pos, delta.y)) tile.x += 2;
-  viewport.drawImage(level->tileset->image, floor(screen + quater * tileScreenSize / 2), ceil(tileScreenSize / 2), (tile * 2 + quater) * level->tileset->tilesize / 2, level->tileset->tilesize / 2);
-}
-
-static void drawPatch(MvDrawTarget& viewport, vec2i pos, vec2i tile, vec2i screen, vec2i tileScreenSize) {
-  drawQuater(viewport, pos, tile, screen, tileScreenSize, vec2i(0, 0));
-  drawQuater(viewport, pos, tile, screen, tileScreenSize, vec2i(1, 0));
-  drawQuater(viewport, pos, tile, screen, tileScreenSize, vec2i(0, 1));
-  drawQuater(viewport, pos, tile, screen, tileScreenSize, vec2i(1, 1));
+static ImTextureID minimapID(Level* level) { return imID(&level->minimap, level->minimapImage(), level->minimapRevision, &level->memory); }
+
+// Level combo with each level's minimap. Clicking a spot on one opens the level there, in tiles
+static bool levelSelector(vec2i& jump) {
+  Level* old = level;
+  if (ImGui::BeginCombo("##LevelSelect", level->name.c_str(), ImGuiComboFlags_HeightLarge)) {
+    const float height = 48;
+    UI::list(levels.size(), std::find(levels.begin(), levels.end(), level) - levels.begin(), [&](int i) {
+      Level* item = levels[i];
+      vec2f size(min(height * item->width / item->height, height * 2), height);
+      if (item->tileset) {
+        vec2f start = oreVec(ImGui::GetCursorScreenPos());
+        ImGui::Image(minimapID(item), imVec(size));
+        if (ImGui::IsItemClicked()) level = item, jump = (oreVec(ImGui::GetMousePos()) - start) / size * item->size(), ImGui::CloseCurrentPopup();
+      } else ImGui::Dummy(imVec(size));
+      ImGui::SameLine();
+      if (ImGui::Selectable(item->name.c_str(), item == old, 0, ImVec2(0, height))) level = item;
+      if (item == old) ImGui::SetItemDefaultFocus();
+    });
+    ImGui::EndCombo();
+  }
+  return level != old;
 }
 
 void editor() {
+  PROFILE("TiledLevel::editor");
   static std::unique_ptr<MvImage> viewport;
+  static Memory::Account viewportMemory;
+  static uint32_t viewportRevision = 0;
   static vec2f camera = 0;
   static float scale = 3;
-  static int menuObject;
+  static int menuObject, dragged = -1;
+  static vec2i dragFrom, grab;
+  static bool showMinimap = true;
+  static int filling = -1;  // Mouse button of a Shift drag filling a rectangle
+  static vec2i fillStart;
+  vec2i jump = -1;  // Cell to center the camera on
   if (!ImGui::Begin("Tiled Level Editor", &showEditor)) return ImGui::End();
   if (!levels.empty()) {
     if (!level) level = levels[0];
-    if (ImGui::BeginCombo("##LevelSelect", level->name.c_str())) {
-      for (const auto item : levels) {
-        if (ImGui::Selectable(item->name.c_str(), item == level)) level = item;
-        if (item == level) ImGui::SetItemDefaultFocus();
-      }
-      ImGui::EndCombo();
-    }
+    if (levelSelector(jump)) object = nullptr;  // It points into the old level's objects
+    ImGui::SameLine();
+    ImGui::Checkbox("Minimap", &showMinimap);
   }
   vec2i viewportSize = availableRegion();
   vec2i viewportPos = oreVec(ImGui::GetCursorScreenPos());
   vec2f mouse = oreVec(ImGui::GetMousePos()) - viewportPos;
-  if (!viewport || viewport->width != viewportSize.x || viewport->height != viewportSize.y) viewport = std::unique_ptr<MvImage>(new MvImage(max(viewportSize, vec2i(1)), nullptr));
+  if (!viewport || viewport->width != viewportSize.x || viewport->height != viewportSize.y) {
+    viewport = std::unique_ptr<MvImage>(new MvImage(max(viewportSize, vec2i(1)), nullptr));
+    viewportMemory.set(Memory::VIEWPORT, viewport->width * viewport->height * sizeof(MvColor));
+  }
 
   if (level && level->tileset) {
-    viewport->clear(MvColor::black);
+    render(*viewport, level, camera, scale);
     vec2f tileScreenSize = level->tileset->tilesize * scale;
-    viewport->fillRect(-camera, tileScreenSize * level->size(), MvColor(135, 206, 235));
-    for (int x = max(camera.x / tileScreenSize.x, 0); x <= min((camera.x + viewport->width) / tileScreenSize.x, level->width - 1); x++) {
-      for (int y = max(camera.y / tileScreenSize.y, 0); y <= min((camera.y + viewport->height) / tileScreenSize.y, level->height - 1); y++) {
-        vec2i tile = level->getTile(vec2i(x, y));
-        vec2f screen = vec2f(x, y) * tileScreenSize - camera;
-        if (tile != -1) {
-          if (level->tileset->tileset->inPatch(tile)) drawPatch(*viewport, vec2i(x, y), level->tileset->tileset->patch(tile), screen, tileScreenSize);
-          else viewport->drawImage(level->tileset->image, screen, tileScreenSize, tile * level->tileset->tilesize, level->tileset->tilesize);
+    ImGui::Image(imID(viewport.get(), *viewport, ++viewportRevision, &viewportMemory), imVec(viewportSize));
+    bool viewportHovered = ImGui::IsItemHovered();
+
+    // In the top right corner, with the part in view outlined. Clicking or dragging on it moves the view there
+    bool overMinimap = false;
+    if (showMinimap) {
+      float minimapScale = min(4.f, 160.f / max(level->width, level->height));
+      vec2f minimapSize = vec2f(level->size()) * minimapScale, minimapPos = vec2f(viewportSize.x - minimapSize.x - 8, 8);
+      auto drawList = ImGui::GetWindowDrawList();
+      drawList->AddImage(minimapID(level), imVec(viewportPos + minimapPos), imVec(viewportPos + minimapPos + minimapSize));
+      vec2f view = viewportPos + minimapPos + camera / tileScreenSize * minimapScale;
+      drawList->AddRect(imVec(view), imVec(view + vec2f(viewportSize) / tileScreenSize * minimapScale), MvColor::red.value);
+      overMinimap = viewportHovered && inRangeW(mouse, minimapPos, minimapSize);
+      if (overMinimap && Mova::isMouseButtonHeld(MOUSE_LEFT)) jump = (mouse - minimapPos) / minimapScale;
+    }
+    if (jump != -1) camera = (vec2f(jump) + 0.5f) * tileScreenSize - vec2f(viewportSize) / 2;
+
+    // Objects are dragged from where they were grabbed, snapped to cells unless Alt is held
+    vec2i world = (mouse + camera) / scale;
+    if (dragged != -1 && dragged < level->objects.size()) {
+      Object& object = level->objects[dragged];
+      vec2i pos = Mova::isKeyHeld(MvKey::Alt) ? world - grab : (world - grab + level->tileset->tilesize / 2) / level->tileset->tilesize * level->tileset->tilesize;
+      if (object.pos != pos) object.pos = pos, level->dirty = true;
+      if (!Mova::isMouseButtonHeld(MOUSE_LEFT)) {
+        if (object.pos != dragFrom) Journal::objectMoved(level, dragged), History::objectMoved(level, dragged, dragFrom);
+        dragged = -1;
+      }
+    } else dragged = -1;
+
+    // Shift and drag fills the rectangle with the selected tile, or clears it with the right button
+    if (filling != -1) {
+      vec2i end = max(vec2i(0), min(level->size() - 1, vec2i((mouse + camera) / tileScreenSize)));
+      vec2i start = min(fillStart, end), size = max(fillStart, end) - start + 1;
+      vec2f screen = viewportPos + start * tileScreenSize - camera;
+      ImGui::GetWindowDrawList()->AddRect(imVec(screen), imVec(screen + size * tileScreenSize), MvColor::red.value, 0.f, 0, 2.f);
+      if (!Mova::isMouseButtonHeld(filling)) {
+        if (filling == MOUSE_RIGHT || Textures::atlas == level->tileset) {
+          size_t cells = fill(level, start, size, filling == MOUSE_RIGHT ? vec2i(-1) : Textures::selected);
+          status = format("Filled %d cells", (int)cells);
         }
+        filling = -1;
       }
     }
-    for (const auto& object : level->objects) {
-      viewport->drawImage(object.parent->atlas->image, (vec2f)object.pos / level->tileset->tilesize * tileScreenSize - camera, object.parent->atlas->tilesize * scale, 0, object.parent->atlas->tilesize);
-    }
-    ImGui::Image(imID(*viewport), imVec(viewportSize));
 
-    if (ImGui::IsItemHovered()) {
+    if (viewportHovered && !overMinimap && filling == -1 && dragged == -1) {
       vec2i selected = (mouse + camera) / tileScreenSize;
       if (selected.x >= 0 && selected.x < level->width && selected.y >= 0 && selected.y < level->height || Textures::object) {
-        if (Mova::isMouseButtonHeld(MOUSE_LEFT) && !Mova::isKeyHeld(MvKey::Ctrl)) {
+        bool inLevel = selected.x >= 0 && selected.x < level->width && selected.y >= 0 && selected.y < level->height;
+        if (inLevel && Mova::isKeyHeld(MvKey::ShiftLeft) && !Textures::object && (Mova::isMouseButtonPressed(MOUSE_LEFT) || Mova::isMouseButtonPressed(MOUSE_RIGHT))) {
+          filling = Mova::isMouseButtonPressed(MOUSE_LEFT) ? MOUSE_LEFT : MOUSE_RIGHT, fillStart = selected;
+        } else if (Mova::isMouseButtonHeld(MOUSE_LEFT) && !Mova::isKeyHeld(MvKey::Ctrl)) {
           bool found = false;
-          for (auto& object : level->objects) {
+          for (int i = 0; i < level->objects.size(); i++) {
+            Object& object = level->objects[i];
             if (inRangeW<vec2i>(mouse, (vec2f)object.pos / level->tileset->tilesize * tileScreenSize - camera, object.parent->atlas->tilesize * scale)) {
               TiledLevel::object = &object;
+              if (Mova::isMouseButtonPressed(MOUSE_LEFT)) dragged = i, dragFrom = object.pos, grab = world - object.pos;
               found = true;
               break;
             }
           }
           if (found) {
-          } else if (Textures::object) level->objects.push_back(Object(Textures::object, Mova::isKeyHeld(MvKey::Alt) ? vec2i((mouse + camera) / scale) : selected * level->tileset->tilesize));
+          } else if (Textures::object) {
+            level->objects.push_back(Object(Textures::object, Mova::isKeyHeld(MvKey::Alt) ? world : selected * level->tileset->tilesize));
+            level->dirty = true;
+            Journal::objectAdded(level, level->objects.size() - 1);
+            History::objectAdded(level, level->objects.size() - 1);
+          }
           else if (Textures::atlas == level->tileset) level->setTile(selected, Textures::selected);
         } else if (Mova::isMouseButtonHeld(MOUSE_RIGHT) && !Mova::isKeyHeld(MvKey::Ctrl)) {
           bool found = false;
@@ -113,7 +164,10 @@ void editor() {
   if (ImGui::BeginPopup("Object Settings")) {
     if (ImGui::MenuItem("Remove Object")) {
       if (&level->objects[menuObject] == TiledLevel::object) TiledLevel::object = nullptr;
+      History::objectRemoved(level, menuObject);
       level->objects.erase(level->objects.begin() + menuObject);
+      level->dirty = true;
+      Journal::objectRemoved(level, menuObject);
     }
     ImGui::EndPopup();
   }
@@ -121,54 +175,6 @@ void editor() {
   ImGui::End();
 }
 
-void save() {
-  for (const auto level : levels) {
-    level->save();
-  }
-}
-
-void load() {
-  for (const auto& entry : fs::directory_iterator(projectSaveDirectory + "levels/")) {
-    if (entry.path().extension() == ".lvl") levels.push_back(new Level(entry.path().stem().string()));
-  }
-  level = levels.empty() ? nullptr : levels[0];
-}
-
-void exportData() {
-  if (!level) return;
-  std::string data = "const uint8_t PROGMEM levels[] = {\n  ";
-  data += itobytes(levels.size(), 2);
-  for (const auto level : levels) {
-    data += itobytes(level->width, 2);
-    data += itobytes(level->height, 2);
-    for (int y = 0; y < level->height; y++) {
-      for (int x = 0; x < level->width; x++) {
-        vec2i tile = level->getTile(vec2i(x, y));
-        if (tile == -1) data += "0, ";
-        else data += itobytes(tile.x + tile.y * level->tileset->image.width / level->tileset->tilesize.x + 1, 1);
-      }
-    }
-    uint32_t objectsDataSizeInsert = data.size();
-    data += itobytes(level->objects.size(), 2);
-    for (const auto& object : level->objects) {
-      data += itobytes(object.pos.x, 2) + itobytes(object.pos.y, 2);
-      data += itobytes(std::find(Textures::objects.begin(), Textures::objects.end(), object.parent) - Textures::objects.begin(), 2);
-      for (int i = 0; i < object.properties.size(); i++) {
-        auto type = object.parent->properties[i].type;
-        if (type == Textures::PropertyType::INT) data += itobytes(std::stoi(object.properties[i]), 4);
-        else if (type == Textures::PropertyType::STRING) {
-          for (auto character : object.properties[i]) data += format("%d, ", (uint8_t)character);
-          data += "0, ";
-        }
-      }
-    }
-    data.insert(objectsDataSizeInsert, itobytes(std::count(data.begin() + objectsDataSizeInsert, data.end(), ','), 4));
-  }
-  for (int i = 0; i < 2; i++) data.pop_back();
-  data += "\n};";
-  Mova::copyToClipboard(data);
-}
-
 void windows() {
   if (showLevelSettingsPopup) ImGui::OpenPopup("Level settings");
   if (ImGui::BeginPopupModal("Level settings", nullptr, ImGuiWindowFlags_AlwaysAutoResize)) {
@@ -201,10 +207,12 @@ void windows() {
 
     ImGui::BeginDisabled(disabled);
     if (ImGui::Button("Ok")) {
-      if (!level) levels.push_back(level = new Level(levelName, tileset, levelSize.x, levelSize.y));
+      if (!level) levels.push_back(level = new Level(levelName, tileset, levelSize.x, levelSize.y)), Journal::newLevel(level);
       else {
+        History::begin();
         level->resize(levelSize);
-        level->tileset = tileset;
+        if (level->tileset != tileset) History::levelTileset(level), level->tileset = tileset, level->dirty = true, Journal::levelTileset(level);
+        History::end();
       }
       ImGui::CloseCurrentPopup();
     }
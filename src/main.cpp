@@ -6,6 +6,8 @@
 void renderViewport() {
   Textures::windows();
   TiledLevel::windows();
+  if (Profiler::show) Profiler::window();
+  if (Memory::show) Memory::window();
 }
 
 namespace UI {
@@ -24,7 +26,7 @@ MvImage colorPicker = MvImage("Assets/res/image/ui/tool/colorPicker.png");
 
 ImGuiID dockspaceID;
 MvWindow* window;
-std::string status, projectSaveDirectory;
+std::string status;
 
 enum class Layout {
   PIXEL_TILE,
@@ -45,12 +47,15 @@ void setLayout(Layout layout) {
     ImGui::DockBuilderDockWindow("Texture Atlas", bottomPanel);
     ImGui::DockBuilderDockWindow("Inspector", leftPanel);
     ImGui::DockBuilderDockWindow("Objects", bottomPanel);
+    ImGui::DockBuilderDockWindow("Profiler", bottomPanel);
+    ImGui::DockBuilderDockWindow("Memory", bottomPanel);
   }
 }
 
 int main(int argc, const char** argv) {
   window = new MvWindow("Ore Asset Editor", MvRendererType::OpenGL);
   Mova::ImGui_Init(*window);
+  TextureCache::backend = TextureCache::openGL();
 
   SetupImGuiStyle();
   ImGui::GetIO().ConfigFlags = ImGuiConfigFlags_NavEnableKeyboard | ImGuiConfigFlags_DockingEnable;
@@ -60,6 +65,17 @@ int main(int argc, const char** argv) {
   while (window->isOpen) {
     Mova::ImGui_NewFrame();
     status = "";
+    {
+      PROFILE("Project::update");
+      Project::update();
+    }
+    Saver::update();
+    if (Saver::saving()) status = "Saving...";
+    Journal::update();
+    // Whatever is edited while a mouse button is held is one undo step, a stroke or a drag
+    static bool gesture = false;
+    bool mouseHeld = !Project::loading() && (Mova::isMouseButtonHeld(MOUSE_LEFT) || Mova::isMouseButtonHeld(MOUSE_RIGHT) || Mova::isMouseButtonHeld(MOUSE_MIDDLE));
+    if (mouseHeld != gesture) (gesture = mouseHeld) ? History::begin() : History::end();
     if (!dockspaceID) {
       dockspaceID = ImGui::DockSpaceOverViewport(ImGui::GetMainViewport());
       setLayout(Layout::PIXEL_TILE);                                      // TODO: Default layout?
@@ -67,13 +83,25 @@ int main(int argc, const char** argv) {
     } else dockspaceID = ImGui::DockSpaceOverViewport(ImGui::GetMainViewport());
 
     ImGui::BeginMainMenuBar();
+    ImGui::BeginDisabled(Project::loading());
     if (ImGui::BeginMenu("File")) {
-      if (ImGui::MenuItem("Open project", "CTRL+O")) loadProject(projectSaveDirectory = openDir());
+      if (ImGui::MenuItem("Open project", "CTRL+O")) loadProject(keepOldIfEmpty(projectSaveDirectory, openDir()));
       if (ImGui::MenuItem("Save project", "CTRL+S")) saveProject();
-      if (ImGui::MenuItem("Save project as", "CTRL+SHIFT+S")) saveProject(projectSaveDirectory = openDir());
+      if (ImGui::MenuItem("Save project as", "CTRL+SHIFT+S")) saveProject(keepOldIfEmpty(projectSaveDirectory, openDir()));
       if (ImGui::MenuItem("Open project's folder", "CTRL+K")) openProjectsFolder();
-      if (ImGui::MenuItem("Export texture atlases")) Textures::exportData();
-      if (ImGui::MenuItem("Export levels")) TiledLevel::exportData();
+      static ExportOrder pixels = ExportOrder::ROWS, cells = ExportOrder::ROWS;
+      static bool quarters = false, strip = false;
+      if (ImGui::MenuItem("Export texture atlases")) Mova::copyToClipboard(Textures::exportData(pixels, strip));
+      if (ImGui::MenuItem("Export levels") && !TiledLevel::levels.empty()) Mova::copyToClipboard(TiledLevel::exportData(cells, quarters, strip));
+      if (ImGui::MenuItem("Export level colliders") && !TiledLevel::levels.empty()) Mova::copyToClipboard(TiledLevel::exportColliders());
+      if (ImGui::BeginMenu("Export layout")) {
+        if (ImGui::MenuItem("Tile pixels column by column", nullptr, pixels == ExportOrder::COLUMNS)) pixels = pixels == ExportOrder::ROWS ? ExportOrder::COLUMNS : ExportOrder::ROWS;
+        if (ImGui::MenuItem("Level cells column by column", nullptr, cells == ExportOrder::COLUMNS)) cells = cells == ExportOrder::ROWS ? ExportOrder::COLUMNS : ExportOrder::ROWS;
+        ImGui::MenuItem("Bake patch quarters into level cells", nullptr, &quarters);
+        ImGui::MenuItem("Strip tiles no level uses", nullptr, &strip);
+        ImGui::EndMenu();
+      }
+      if (ImGui::MenuItem("Export as C++ header")) exportHeader(saveFile("h"));
       ImGui::EndMenu();
     }
     if (Mova::isKeyHeld(MvKey::Ctrl) && Mova::isKeyPressed(MvKey::O)) loadProject(keepOldIfEmpty(projectSaveDirectory, openDir()));
@@ -81,6 +109,16 @@ int main(int argc, const char** argv) {
     if (Mova::isKeyHeld(MvKey::Ctrl) && Mova::isKeyHeld(MvKey::ShiftLeft) && Mova::isKeyPressed(MvKey::S)) saveProject(keepOldIfEmpty(projectSaveDirectory, openDir()));
     if (Mova::isKeyHeld(MvKey::Ctrl) && Mova::isKeyPressed(MvKey::K)) openProjectsFolder();
 
+    bool undo = false, redo = false;
+    if (ImGui::BeginMenu("Edit")) {
+      undo = ImGui::MenuItem("Undo", "CTRL+Z", false, History::canUndo());
+      redo = ImGui::MenuItem("Redo", "CTRL+Y", false, History::canRedo());
+      ImGui::EndMenu();
+    }
+    if (Mova::isKeyHeld(MvKey::Ctrl) && Mova::isKeyPressed(MvKey::Z) && !ImGui::GetIO().WantTextInput) (Mova::isKeyHeld(MvKey::ShiftLeft) ? redo : undo) = true;
+    if (Mova::isKeyHeld(MvKey::Ctrl) && Mova::isKeyPressed(MvKey::Y) && !ImGui::GetIO().WantTextInput) redo = true;
+    if (!Project::loading() && ((undo && History::undo()) || (redo && History::redo()))) TiledLevel::object = nullptr;  // Objects may have moved in their vector
+
     if (ImGui::BeginMenu("Level")) {
       if (ImGui::MenuItem("New level")) TiledLevel::newLevel();
       if (ImGui::MenuItem("Level settings")) TiledLevel::levelSettings();
@@ -89,6 +127,7 @@ int main(int argc, const char** argv) {
 
     if (ImGui::BeginMenu("Texture")) {
       if (ImGui::MenuItem("Import texture atlas")) Textures::importAtlas(openFile());
+      if (ImGui::MenuItem("Import sprites folder")) Textures::importSprites(openDir());
       if (ImGui::MenuItem("Atlas settins")) Textures::atlasSettings();
       ImGui::EndMenu();
     }
@@ -96,14 +135,25 @@ int main(int argc, const char** argv) {
     if (ImGui::BeginMenu("View")) {
       if (ImGui::MenuItem("Texture atlas", nullptr, Textures::showAtlas)) Textures::showAtlas = !Textures::showAtlas;
       if (ImGui::MenuItem("Tiled Level Editor", nullptr, TiledLevel::showEditor)) TiledLevel::showEditor = !TiledLevel::showEditor;
+      if (ImGui::MenuItem("Profiler", nullptr, Profiler::show)) Profiler::show = !Profiler::show;
+      if (ImGui::MenuItem("Memory", nullptr, Memory::show)) Memory::show = !Memory::show;
       ImGui::Separator();
       if (ImGui::MenuItem("Pixel / Tile workspace layout")) setLayout(Layout::PIXEL_TILE);
+      ImGui::Separator();
+      int budget = Cache::budget >> 20;
+      if (ImGui::InputInt("Memory budget, MB", &budget)) Cache::budget = (size_t)max(budget, 16) << 20;
+      int historyBudget = History::budget >> 20;
+      if (ImGui::InputInt("Undo history, MB", &historyBudget)) History::budget = (size_t)max(historyBudget, 1) << 20;
       ImGui::EndMenu();
     }
+    ImGui::EndDisabled();
     ImGui::EndMainMenuBar();
 
     // Mova::setCursor(MvCursor::Default);
-    renderViewport();
+    if (!Project::loading()) {
+      PROFILE("Windows");
+      renderViewport();
+    }
 
     if (ImGui::BeginViewportSideBar("##MainStatusBar", ImGui::GetMainViewport(), ImGuiDir_Down, ImGui::GetFrameHeight(), ImGuiWindowFlags_MenuBar)) {
       if (ImGui::BeginMenuBar()) {
@@ -115,14 +165,23 @@ int main(int argc, const char** argv) {
 
     glClearColor(MvColor::darkgray);
     glClear(GL_COLOR_BUFFER_BIT);
-    Mova::ImGui_Render();
+    {
+      PROFILE("ImGui render");
+      Mova::ImGui_Render();
+    }
     Mova::nextFrame();
+    Cache::nextFrame(!Project::loading() && !Saver::saving());  // Trimming mid-save could drop pixels or tiles whose file isn't written yet
+    TextureCache::nextFrame();
+    Profiler::nextFrame();
   }
 
+  Saver::wait();
+  Journal::close();
+  TextureCache::clear();
   Mova::ImGui_Shutdown();
   delete window;
-  for (auto atlas : Textures::atlases) delete atlas;
-  for (auto object : Textures::objects) delete object;
   for (auto object : TiledLevel::levels) delete object;
+  for (auto object : Textures::objects) delete object;
+  for (auto atlas : Textures::atlases) delete atlas;
   return 0;
 }
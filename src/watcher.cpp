@@ -0,0 +1,113 @@
+#include "watcher.hpp"
+#include "common.hpp"
+#include <unordered_map>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/inotify.h>
+#else
+#include <chrono>
+#endif
+
+namespace Watcher {
+#ifdef __linux__
+struct Watch {
+  std::string folder;
+  bool recursive;
+};
+
+static int fd = -1;
+static std::unordered_map<int, Watch> watches;
+
+// Files already in a folder that appeared after we started watching get reported too, they may have been written before
+// the watch was added
+static void add(const std::string& folder, bool recursive, std::vector<std::string>* existing = nullptr) {
+  int wd = inotify_add_watch(fd, folder.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+  if (wd < 0) return;
+  watches[wd] = {folder, recursive};
+  std::error_code error;
+  for (const auto& entry : fs::directory_iterator(folder, error)) {
+    if (!entry.is_directory()) {
+      if (existing) existing->push_back(entry.path().string());
+    } else if (recursive) add(entry.path().string() + "/", true, existing);
+  }
+}
+
+void watch(const std::string& folder, bool recursive) {
+  if (fd == -1) fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd != -1) add(folder, recursive);
+}
+
+void clear() {
+  if (fd != -1) close(fd), fd = -1;
+  watches.clear();
+}
+
+std::vector<std::string> poll() {
+  std::vector<std::string> changed;
+  if (fd == -1) return changed;
+  alignas(inotify_event) char buffer[16 * 1024];
+  ssize_t size;
+  while ((size = read(fd, buffer, sizeof(buffer))) > 0) {
+    for (char* ptr = buffer; ptr < buffer + size; ptr += sizeof(inotify_event) + ((inotify_event*)ptr)->len) {
+      auto event = (inotify_event*)ptr;
+      auto watch = watches.find(event->wd);
+      if (watch == watches.end() || !event->len) continue;
+      std::string path = watch->second.folder + event->name;
+      if (event->mask & IN_ISDIR) {
+        if (watch->second.recursive && event->mask & (IN_CREATE | IN_MOVED_TO)) changed.push_back(path), add(path + "/", true, &changed);
+      } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+        changed.push_back(path);  // IN_CREATE alone means the file isn't written yet
+      }
+    }
+  }
+  std::sort(changed.begin(), changed.end());
+  changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+  return changed;
+}
+#else
+struct Watch {
+  std::string folder;
+  bool recursive;
+};
+
+static std::vector<Watch> watches;
+static std::unordered_map<std::string, fs::file_time_type> seen;
+static auto lastScan = std::chrono::steady_clock::now();
+
+template <typename Iterator> static void scan(Iterator iterator, std::vector<std::string>* changed) {
+  std::error_code error;
+  for (const auto& entry : iterator) {
+    auto time = fs::last_write_time(entry.path(), error);
+    if (error) continue;
+    auto [it, inserted] = seen.try_emplace(entry.path().string(), time);
+    if (!inserted && it->second == time) continue;
+    it->second = time;
+    if (changed) changed->push_back(entry.path().string());
+  }
+}
+
+static void scan(const Watch& watch, std::vector<std::string>* changed) {
+  std::error_code error;
+  if (watch.recursive) scan(fs::recursive_directory_iterator(watch.folder, error), changed);
+  else scan(fs::directory_iterator(watch.folder, error), changed);
+}
+
+void watch(const std::string& folder, bool recursive) {
+  watches.push_back({folder, recursive});
+  scan(watches.back(), nullptr);
+}
+
+void clear() {
+  watches.clear();
+  seen.clear();
+}
+
+std::vector<std::string> poll() {
+  std::vector<std::string> changed;
+  if (std::chrono::steady_clock::now() - lastScan < std::chrono::seconds(1)) return changed;
+  lastScan = std::chrono::steady_clock::now();
+  for (const auto& watch : watches) scan(watch, &changed);
+  return changed;
+}
+#endif
+}  // namespace Watcher
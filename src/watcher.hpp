@@ -0,0 +1,11 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Reports files created or rewritten under the watched folders. inotify on Linux, a once a second scan of modification
+// times everywhere else
+namespace Watcher {
+void watch(const std::string& folder, bool recursive = false);
+void clear();
+std::vector<std::string> poll();
+}  // namespace Watcher
@@ -0,0 +1,289 @@
+#include "core/assets.hpp"
+#include <chrono>
+#include <random>
+#include <map>
+
+// Generates a synthetic project, then times loading, saving, exporting and rendering it. Results go to a JSON file so
+// runs can be compared across commits
+struct Config {
+  int atlases = 8, atlasSize = 256, tilesize = 16;
+  int levels = 8, levelSize = 1024;
+  float patchDensity = 0.3f;  // Share of level tiles that are patches
+  int classes = 1000, instances = 20000;
+  int runs = 3;
+  uint32_t seed = 1;
+  std::string dir, output = "bench.json";
+  bool keep = false;
+};
+
+static std::map<std::string, vector<double>> results;
+
+template <typename F> static void measure(const std::string& name, F f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  results[name].push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
+
+// Tilesets have their patches in the first row, plain tiles below
+static void generate(const Config& config) {
+  std::mt19937 random(config.seed);
+  auto uniform = [&](int n) { return std::uniform_int_distribution<int>(0, n - 1)(random); };
+  for (const char* folder : {"atlases", "objects", "levels"}) fs::create_directories(projectSaveDirectory + folder);
+
+  vector<Saver::Job> jobs;
+  for (int i = 0; i < config.atlases; i++) {
+    std::string name = format("atlas%d", i);
+    MvImage image(vec2i(config.atlasSize), nullptr);
+    for (int y = 0; y < config.atlasSize; y += config.tilesize) {
+      for (int x = 0; x < config.atlasSize; x += config.tilesize) {
+        image.fillRect(vec2i(x, y), vec2i(config.tilesize), MvColor(uniform(256), uniform(256), uniform(256)));
+        image.fillRect(vec2i(x + uniform(config.tilesize / 2), y + uniform(config.tilesize / 2)), vec2i(config.tilesize / 2), MvColor(uniform(256), uniform(256), uniform(256)));
+      }
+    }
+    image.save(Textures::Atlas::pngPath(name));
+    auto atlas = new Textures::Atlas(Textures::Atlas::pngPath(name), vec2i(config.tilesize));
+    atlas->name = name;
+    atlas->tileset = new Textures::Atlas::Tileset();
+    for (int x = 0; x + 4 <= atlas->width(); x += 4) atlas->tileset->patches.push_back(vec2i(x, 0));
+    atlas->tileset->colliders = new bool[atlas->width() * atlas->height()]();
+    for (int j = 0; j < atlas->width() * atlas->height(); j++) atlas->tileset->colliders[j] = uniform(4) == 0;
+    Textures::atlases.push_back(atlas);
+    Textures::atlasNames.add(atlas);
+  }
+  reindex(Textures::atlases);
+
+  // A hundred classes per folder, so the object tree has some depth
+  for (int i = 0; i < config.classes; i++) {
+    std::string name = format("object%d", i);
+    auto object = new Textures::ObjectClass(name, fs::path(projectSaveDirectory) / "objects" / format("group%d", i / 100) / (name + ".obj"), Textures::atlases[uniform(config.atlases)]);
+    for (auto [propertyName, type] : {std::make_pair("health", Textures::PropertyType::INT), std::make_pair("speed", Textures::PropertyType::FLOAT), std::make_pair("name", Textures::PropertyType::STRING)}) {
+      object->addProperty();
+      object->properties.back().name = propertyName, object->properties.back().type = type;
+    }
+    Textures::add(object);
+  }
+
+  for (int i = 0; i < config.levels; i++) {
+    auto tileset = Textures::atlases[i % config.atlases];
+    auto level = new TiledLevel::Level(format("level%d", i), tileset, config.levelSize, config.levelSize);
+    vec2i* tiles = level->tiles();
+    int patches = tileset->tileset->patches.size();
+    for (int j = 0; j < config.levelSize * config.levelSize; j++) {
+      if (patches && uniform(1000) < config.patchDensity * 1000) tiles[j] = tileset->tileset->patches[uniform(patches)];
+      else if (tileset->height() > 1 && uniform(2)) tiles[j] = vec2i(uniform(tileset->width()), 1 + uniform(tileset->height() - 1));
+    }
+    TiledLevel::levels.push_back(level);
+  }
+  for (int i = 0; i < config.instances && !Textures::objects.empty(); i++) {
+    auto level = TiledLevel::levels[uniform(config.levels)];
+    auto& object = level->objects.emplace_back(Textures::objects[uniform(Textures::objects.size())], vec2i(uniform(level->width), uniform(level->height)) * config.tilesize);
+    object.property(0).i = uniform(100);
+    object.property(1).f = uniform(1000) / 100.f;
+    object.property(2).s = Strings::intern(format("instance%d", uniform(1000)));
+  }
+
+  Textures::save(jobs);
+  TiledLevel::save(jobs);
+  for (const auto& job : jobs) {
+    fs::create_directories(fs::path(job.path).parent_path());
+    job.write(job.path);
+  }
+}
+
+static void run() {
+  TiledLevel::clear();
+  measure("load.textures", [] { Textures::load(); });
+  measure("load.levels", [] { TiledLevel::load(); });
+  measure("load.tiles", [] { Jobs::parallelFor(TiledLevel::levels.size(), [](size_t i) { TiledLevel::levels[i]->tiles(); }); });
+  measure("load.images", [] { Jobs::parallelFor(Textures::atlases.size(), [](size_t i) { Textures::atlases[i]->image(); }); });
+
+  // One 1280x720 frame per level, at the editor's default zoom and then zoomed out to the whole level
+  MvImage viewport(vec2i(1280, 720), nullptr);
+  measure("render.default", [&] {
+    for (const auto level : TiledLevel::levels) TiledLevel::render(viewport, level, vec2f(0), 3);
+  });
+  measure("render.zoomedOut", [&] {
+    for (const auto level : TiledLevel::levels) TiledLevel::render(viewport, level, vec2f(0), min(1280.f / (level->width * level->tileset->tilesize.x), 720.f / (level->height * level->tileset->tilesize.y)));
+  });
+
+  // Swaps a tile out of every level of each tileset and back, through a tile outside the atlas that nothing shows
+  measure("edit.replace", [] {
+    for (const auto atlas : Textures::atlases) {
+      TiledLevel::replace(atlas, vec2i(0, 1), vec2i(atlas->width(), 0));
+      TiledLevel::replace(atlas, vec2i(atlas->width(), 0), vec2i(0, 1));
+    }
+  });
+
+  // Fills every level whole with one tile, then undoes that and the replaces above
+  measure("edit.fill", [] {
+    for (const auto level : TiledLevel::levels) TiledLevel::fill(level, vec2i(0), level->size(), vec2i(0, 1));
+  });
+  measure("edit.undo", [] {
+    while (History::undo()) {}
+  });
+
+  measure("export.textures", [] { Textures::exportData(); });
+  measure("export.levels", [] { TiledLevel::exportData(); });
+  measure("export.colliders", [] { TiledLevel::exportColliders(); });
+  measure("export.header", [] { Project::exportHeader(); });
+
+  measure("save", [] {
+    for (const auto atlas : Textures::atlases) atlas->dirty = true;
+    for (const auto object : Textures::objects) object->dirty = true;
+    for (const auto level : TiledLevel::levels) level->dirty = true;
+    vector<Saver::Job> jobs;
+    Textures::save(jobs);
+    TiledLevel::save(jobs);
+    Saver::submit(std::move(jobs), projectSaveDirectory + ".save/");
+    Saver::wait();
+  });
+}
+
+// Drives TextureCache through a RecordingBackend and checks what it would have sent to the GPU. Empty if it all matches
+static std::string checkTextureCache() {
+  TextureCache::RecordingBackend recording;
+  TextureCache::backend = &recording;
+  std::string failed;
+  auto expect = [&](const char* what, std::initializer_list<TextureCache::RecordingBackend::Upload> uploads) {
+    bool same = recording.uploads.size() == uploads.size();
+    for (int i = 0; same && i < uploads.size(); i++) same = recording.uploads[i].pos == uploads.begin()[i].pos && recording.uploads[i].size == uploads.begin()[i].size;
+    if (!same) failed += format("%s: %d uploads, expected %d\n", what, (int)recording.uploads.size(), (int)uploads.size());
+    recording.uploads.clear();
+  };
+
+  MvImage image(vec2i(64, 32), nullptr);
+  TextureCache::get(&image, image);
+  expect("first get", {{0, 0, vec2i(64, 32)}});
+  TextureCache::get(&image, image);
+  expect("clean get", {});
+  TextureCache::markDirty(&image, vec2i(2, 3), vec2i(4));
+  TextureCache::get(&image, image);
+  expect("dirty rect", {{0, vec2i(2, 3), vec2i(4)}});
+  TextureCache::markDirty(&image, vec2i(0), vec2i(4));
+  TextureCache::markDirty(&image, vec2i(2), vec2i(4));
+  TextureCache::markDirty(&image, vec2i(60, 30), vec2i(8));
+  TextureCache::get(&image, image);
+  expect("merged and clipped rects", {{0, vec2i(0), vec2i(6)}, {0, vec2i(60, 30), vec2i(4, 2)}});
+  for (int i = 0; i < 17; i++) TextureCache::markDirty(&image, vec2i(i * 3, i), vec2i(1));  // One over the limit
+  TextureCache::get(&image, image);
+  expect("too many rects", {{0, vec2i(0), vec2i(49, 17)}});
+  TextureCache::get(&image, image, 1);
+  expect("new revision", {{0, 0, vec2i(64, 32)}});
+
+  // Every paint reaches the texture, also the ones after it was drawn mid-stroke
+  Textures::Atlas atlas(std::make_unique<MvImage>(vec2i(32), nullptr), vec2i(8));
+  TextureCache::get(&atlas, atlas.image(), atlas.revision);
+  recording.uploads.clear();
+  atlas.paint(vec2i(9, 1), MvColor(255, 0, 0));
+  TextureCache::get(&atlas, atlas.image(), atlas.revision);
+  atlas.paint(vec2i(10, 2), MvColor(255, 0, 0));
+  TextureCache::get(&atlas, atlas.image(), atlas.revision);
+  TextureCache::get(&atlas, atlas.image(), atlas.revision);
+  expect("painting a tile", {{0, vec2i(8, 0), vec2i(8)}, {0, vec2i(8, 0), vec2i(8)}});
+
+  // Unused textures are released and sent whole when they're needed again
+  uint64_t releaseAfter = std::exchange(TextureCache::releaseAfter, 2);
+  for (int i = 0; i < 4; i++) TextureCache::get(&image, image, 1), TextureCache::nextFrame();
+  if (recording.live.size() != 1) failed += format("release: %d textures live, expected 1\n", (int)recording.live.size());
+  TextureCache::get(&atlas, atlas.image(), atlas.revision);
+  expect("get after release", {{0, 0, vec2i(32)}});
+  TextureCache::release(&atlas);
+  TextureCache::nextFrame();
+  if (recording.live.size() != 1) failed += format("owner gone: %d textures live, expected 1\n", (int)recording.live.size());
+
+  TextureCache::releaseAfter = releaseAfter;
+  TextureCache::clear();
+  if (!recording.live.empty()) failed += "clear left textures live\n";
+  TextureCache::backend = nullptr;
+  return failed;
+}
+
+static std::string json(const Config& config) {
+  std::string out = "{\n  \"config\": {";
+  out += format("\"atlases\": %d, \"atlasSize\": %d, \"tilesize\": %d, \"levels\": %d, \"levelSize\": %d, \"patchDensity\": %g, ", config.atlases, config.atlasSize, config.tilesize, config.levels, config.levelSize, config.patchDensity);
+  out += format("\"classes\": %d, \"instances\": %d, \"runs\": %d, \"seed\": %u, \"threads\": %d},\n", config.classes, config.instances, config.runs, config.seed, Jobs::threads());
+  out += "  \"results\": {";
+  bool first = true;
+  for (auto& [name, times] : results) {
+    vector<double> sorted = times;
+    std::sort(sorted.begin(), sorted.end());
+    out += format("%s\n    \"%s\": {\"min\": %.3f, \"median\": %.3f, \"max\": %.3f, \"runs\": [", first ? "" : ",", name.c_str(), sorted.front(), sorted[sorted.size() / 2], sorted.back());
+    for (int i = 0; i < times.size(); i++) out += format("%s%.3f", i ? ", " : "", times[i]);
+    out += "]}";
+    first = false;
+  }
+  // Peaks over the whole benchmark, generating included
+  out += "\n  },\n  \"memory\": {";
+  for (int kind = 0; kind < Memory::KINDS; kind++) out += format("%s\n    \"%s\": {\"bytes\": %lld, \"peak\": %lld}", kind ? "," : "", Memory::kindNames[kind], (long long)Memory::totals[kind].bytes, (long long)Memory::totals[kind].peak);
+  out += format(",\n    \"total\": {\"bytes\": %lld, \"peak\": %lld}", (long long)Memory::all.bytes, (long long)Memory::all.peak);
+  return out + "\n  }\n}\n";
+}
+
+static int usage() {
+  fprintf(stderr, "Usage: ore-bench [options]\n");
+  fprintf(stderr, "  --atlases N --atlas-size PX --tilesize PX\n");
+  fprintf(stderr, "  --levels N --level-size TILES (up to 4096) --patch-density 0..1\n");
+  fprintf(stderr, "  --classes N --instances N\n");
+  fprintf(stderr, "  --runs N --seed N --dir FOLDER --keep --output FILE (bench.json)\n");
+  return 1;
+}
+
+int main(int argc, const char** argv) {
+  Config config;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--keep") {
+      config.keep = true;
+      continue;
+    }
+    if (i + 1 == argc) return usage();
+    const char* value = argv[++i];
+    if (arg == "--atlases") config.atlases = atoi(value);
+    else if (arg == "--atlas-size") config.atlasSize = atoi(value);
+    else if (arg == "--tilesize") config.tilesize = atoi(value);
+    else if (arg == "--levels") config.levels = atoi(value);
+    else if (arg == "--level-size") config.levelSize = atoi(value);
+    else if (arg == "--patch-density") config.patchDensity = atof(value);
+    else if (arg == "--classes") config.classes = atoi(value);
+    else if (arg == "--instances") config.instances = atoi(value);
+    else if (arg == "--runs") config.runs = atoi(value);
+    else if (arg == "--seed") config.seed = atoi(value);
+    else if (arg == "--dir") config.dir = value;
+    else if (arg == "--output") config.output = value;
+    else return usage();
+  }
+  if (config.atlases < 1 || config.levels < 1 || config.runs < 1 || config.tilesize < 2 || config.atlasSize < config.tilesize || !inRange(config.levelSize, 1, 4097)) return usage();
+
+  std::string textureCache = checkTextureCache();
+  if (!textureCache.empty()) return fprintf(stderr, "ore-bench: TextureCache check failed\n%s", textureCache.c_str()), 4;
+
+  // Only a folder the bench made itself, marked by a file it leaves there, is ever cleared
+  fs::path dir = config.dir.empty() ? fs::temp_directory_path() / format("ore-bench-%u", config.seed) : fs::path(config.dir);
+  std::error_code error;
+  if (fs::exists(dir, error) && !fs::is_empty(dir, error) && !fs::exists(dir / ".ore-bench", error)) {
+    return fprintf(stderr, "ore-bench: %s isn't empty and wasn't made by ore-bench, pick another --dir\n", dir.string().c_str()), usage();
+  }
+  fs::remove_all(dir, error);
+  fs::create_directories(dir, error);
+  if (!File((dir / ".ore-bench").string(), "wb")()) return fprintf(stderr, "ore-bench: can't write to %s\n", dir.string().c_str()), 3;
+  projectSaveDirectory = (dir / "").string();
+
+  try {
+    measure("generate", [&] { generate(config); });
+    for (int i = 0; i < config.runs; i++) {
+      run();
+      fprintf(stderr, "ore-bench: run %d/%d done\n", i + 1, config.runs);
+    }
+  } catch (const std::exception& e) {
+    fprintf(stderr, "ore-bench: %s\n", e.what());
+    return 2;
+  }
+
+  Memory::refresh();
+  std::string out = json(config);
+  File file(config.output, "wb");
+  if (!file() || fwrite(out.data(), 1, out.size(), file()) != out.size()) return fprintf(stderr, "ore-bench: can't write %s\n", config.output.c_str()), 3;
+  fputs(out.c_str(), stdout);
+  if (!config.keep) fs::remove_all(dir, error);
+  return 0;
+}
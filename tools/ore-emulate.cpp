@@ -0,0 +1,92 @@
+#include "core/emulator.hpp"
+
+// Renders a level as the SSD1351 firmware would from the exported arrays, to check an export without a board. With
+// --golden the frame is compared against a PNG, so it can run in asset builds
+enum Exit {
+  OK,
+  USAGE,
+  LOAD_FAILED,
+  RENDER_FAILED,
+  MISMATCH,  // The frame differs from the golden image
+};
+
+static std::string read(const std::string& path) {
+  File file(path, "rb");
+  if (!file()) throw std::runtime_error("Can't read " + path);
+  std::string data;
+  char buffer[4096];
+  for (size_t n; (n = fread(buffer, 1, sizeof(buffer), file())) > 0;) data.append(buffer, n);
+  return data;
+}
+
+static int usage() {
+  fprintf(stderr, "Usage: ore-emulate [--exported FOLDER] [--golden PNG] [--output PNG] [--pixels ORDER] [--cells ORDER] [--quarters] [--strip] <project folder> <level> [camera x] [camera y]\n");
+  fprintf(stderr, "Renders a 128x128 frame of the level (name or index) from the exported arrays and prints the bytes read\n");
+  fprintf(stderr, "--exported reads textures.h and levels.h written earlier instead of exporting the project again\n");
+  fprintf(stderr, "--pixels rows|columns, --cells rows|columns, --quarters and --strip pick the layout otherwise, as ore-export does\n");
+  return USAGE;
+}
+
+int main(int argc, const char** argv) {
+  std::string exported, golden, output = "frame.png";
+  ExportOrder pixels = ExportOrder::ROWS, cells = ExportOrder::ROWS;
+  bool quarters = false, strip = false;
+  vector<std::string> args;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-h" || arg == "--help") return usage();
+    if (arg == "--exported" || arg == "--golden" || arg == "--output") {
+      if (i + 1 == argc) return usage();
+      (arg == "--exported" ? exported : arg == "--golden" ? golden : output) = argv[++i];
+    } else if (arg == "--pixels" || arg == "--cells") {
+      if (i + 1 == argc || !parseExportOrder(argv[++i], arg == "--pixels" ? pixels : cells)) return usage();
+    } else if (arg == "--quarters") quarters = true;
+    else if (arg == "--strip") strip = true;
+    else args.push_back(arg);
+  }
+  if (args.size() < 2 || args.size() > 4) return usage();
+  vec2i camera(args.size() > 2 ? atoi(args[2].c_str()) : 0, args.size() > 3 ? atoi(args[3].c_str()) : 0);
+
+  projectSaveDirectory = args[0];
+  if (projectSaveDirectory.back() != '/' && projectSaveDirectory.back() != '\\') projectSaveDirectory += '/';
+  try {
+    Project::load();
+  } catch (const std::exception& e) {
+    fprintf(stderr, "ore-emulate: failed to load %s: %s\n", projectSaveDirectory.c_str(), e.what());
+    return LOAD_FAILED;
+  }
+  for (const auto& message : Textures::takeMissing()) fprintf(stderr, "ore-emulate: missing reference: %s\n", message.c_str());
+
+  // The level's tileset isn't in the export, it comes from the project
+  TiledLevel::Level* level = nullptr;
+  for (const auto candidate : TiledLevel::levels) {
+    if (candidate->name == args[1]) level = candidate;
+  }
+  if (!level && isdigit(args[1][0]) && atoi(args[1].c_str()) < TiledLevel::levels.size()) level = TiledLevel::levels[atoi(args[1].c_str())];
+  if (!level) return fprintf(stderr, "ore-emulate: no level %s\n", args[1].c_str()), USAGE;
+  int index = std::find(TiledLevel::levels.begin(), TiledLevel::levels.end(), level) - TiledLevel::levels.begin();
+
+  try {
+    std::string textures = exported.empty() ? Textures::exportData(pixels, strip) : read((fs::path(exported) / "textures.h").string());
+    std::string levels = exported.empty() ? TiledLevel::exportData(cells, quarters, strip) : read((fs::path(exported) / "levels.h").string());
+    Emulator::Device device(textures, levels, Emulator::schemas());
+    device.render(index, level->tileset->index, camera);
+    const auto& fetched = device.fetched;
+    printf("%s at %d, %d: %llu bytes read in %llu bursts (index %llu, tiles %llu, pixels %llu, objects %llu)\n", level->name.c_str(), camera.x, camera.y, (unsigned long long)fetched.total(), (unsigned long long)fetched.bursts, (unsigned long long)fetched.index, (unsigned long long)fetched.tiles, (unsigned long long)fetched.pixels, (unsigned long long)fetched.objects);
+
+    MvImage frame = device.image();
+    if (!output.empty()) frame.save(output);
+    if (!golden.empty()) {
+      MvImage expected(golden);
+      int different = 0;
+      for (int y = 0; y < Emulator::SIZE; y++) {
+        for (int x = 0; x < Emulator::SIZE; x++) different += expected.width != Emulator::SIZE || expected.height != Emulator::SIZE || rgb565(expected.getPixel(x, y)) != device.framebuffer[x + y * Emulator::SIZE];
+      }
+      if (different) return fprintf(stderr, "ore-emulate: %d pixels differ from %s\n", different, golden.c_str()), MISMATCH;
+    }
+  } catch (const std::exception& e) {
+    fprintf(stderr, "ore-emulate: %s\n", e.what());
+    return RENDER_FAILED;
+  }
+  return OK;
+}
@@ -0,0 +1,82 @@
+#include "core/assets.hpp"
+
+// Loads a project and writes what the editor's Export menu copies to the clipboard, for asset builds on machines
+// without a display
+enum Exit {
+  OK,
+  USAGE,
+  LOAD_FAILED,         // A folder or file of the project couldn't be read
+  MISSING_REFERENCES,  // Something refers to an atlas or object class that isn't there
+  EXPORT_FAILED,
+};
+
+static bool write(const std::string& path, const std::string& data) {
+  File file(path, "wb");
+  if (!file() || fwrite(data.data(), 1, data.size(), file()) != data.size()) return false;
+  return Saver::sync(file());
+}
+
+static int usage() {
+  fprintf(stderr, "Usage: ore-export [--allow-missing] [--memory] [--header] [--pixels ORDER] [--cells ORDER] [--quarters] [--strip] <project folder> [output folder]\n");
+  fprintf(stderr, "Writes textures.h, levels.h and colliders.h to the output folder, the current one by default\n");
+  fprintf(stderr, "--header writes ore.h instead, typed tables for the whole project\n");
+  fprintf(stderr, "--pixels rows|columns and --cells rows|columns order tile pixels and level cells, rows by default\n");
+  fprintf(stderr, "--quarters follows every level cell with the pieces its patch quarters are drawn with\n");
+  fprintf(stderr, "--strip leaves out tiles no level uses and numbers the rest without gaps\n");
+  fprintf(stderr, "--memory prints what the project held per subsystem and the biggest assets\n");
+  return USAGE;
+}
+
+int main(int argc, const char** argv) {
+  bool allowMissing = false, memory = false, header = false;
+  ExportOrder pixels = ExportOrder::ROWS, cells = ExportOrder::ROWS;
+  bool quarters = false, strip = false;
+  vector<std::string> paths;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--allow-missing") allowMissing = true;
+    else if (arg == "--memory") memory = true;
+    else if (arg == "--header") header = true;
+    else if (arg == "--quarters") quarters = true;
+    else if (arg == "--strip") strip = true;
+    else if (arg == "--pixels" || arg == "--cells") {
+      if (i + 1 == argc || !parseExportOrder(argv[++i], arg == "--pixels" ? pixels : cells)) return usage();
+    }
+    else if (arg == "-h" || arg == "--help") return usage();
+    else if (arg[0] == '-') return fprintf(stderr, "ore-export: unknown option %s\n", arg.c_str()), usage();
+    else paths.push_back(arg);
+  }
+  if (paths.empty() || paths.size() > 2) return usage();
+
+  projectSaveDirectory = paths[0];
+  if (projectSaveDirectory.back() != '/' && projectSaveDirectory.back() != '\\') projectSaveDirectory += '/';
+  fs::path output = paths.size() > 1 ? paths[1] : ".";
+
+  try {
+    Project::load();
+  } catch (const std::exception& e) {
+    fprintf(stderr, "ore-export: failed to load %s: %s\n", projectSaveDirectory.c_str(), e.what());
+    return LOAD_FAILED;
+  }
+  vector<std::string> missing = Textures::takeMissing();
+  for (const auto& message : missing) fprintf(stderr, "ore-export: missing reference: %s\n", message.c_str());
+  if (!missing.empty() && !allowMissing) return MISSING_REFERENCES;
+
+  try {
+    std::error_code error;
+    fs::create_directories(output, error);
+    vector<std::pair<const char*, std::string>> files;
+    if (header) files = {{"ore.h", Project::exportHeader()}};
+    else files = {{"textures.h", Textures::exportData(pixels, strip)}, {"levels.h", TiledLevel::exportData(cells, quarters, strip)}, {"colliders.h", TiledLevel::exportColliders()}};
+    for (const auto& [name, data] : files) {
+      if (write((output / name).string(), data)) continue;
+      fprintf(stderr, "ore-export: can't write %s\n", (output / name).string().c_str());
+      return EXPORT_FAILED;
+    }
+  } catch (const std::exception& e) {
+    fprintf(stderr, "ore-export: export failed: %s\n", e.what());
+    return EXPORT_FAILED;
+  }
+  if (memory) fputs(Memory::report().c_str(), stderr);
+  return OK;
+}
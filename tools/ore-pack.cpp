@@ -0,0 +1,59 @@
+#include "core/packer.hpp"
+
+// Packs a folder of loose sprite PNGs into atlases of a project and saves them with their sprite maps, for asset
+// builds that get new art
+enum Exit {
+  OK,
+  USAGE,
+  LOAD_FAILED,
+  PACK_FAILED,  // A sprite couldn't be read or fit, or an atlas of that name exists
+  SAVE_FAILED,
+};
+
+static int usage() {
+  fprintf(stderr, "Usage: ore-pack [--tilesize N] [--grid TILES] <project folder> <sprites folder> <atlas name>\n");
+  fprintf(stderr, "Trims, deduplicates and packs every PNG in the sprites folder into atlases named after the given one\n");
+  fprintf(stderr, "--tilesize is the atlas tile size in pixels, 16 by default. --grid is the atlas width in tiles, 16 by default\n");
+  return USAGE;
+}
+
+int main(int argc, const char** argv) {
+  int tilesize = 16, grid = 16;
+  vector<std::string> args;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-h" || arg == "--help") return usage();
+    if (arg == "--tilesize" || arg == "--grid") {
+      if (i + 1 == argc) return usage();
+      (arg == "--tilesize" ? tilesize : grid) = atoi(argv[++i]);
+    } else if (arg[0] == '-') return fprintf(stderr, "ore-pack: unknown option %s\n", arg.c_str()), usage();
+    else args.push_back(arg);
+  }
+  if (args.size() != 3 || tilesize <= 0 || grid <= 0 || grid > Packer::MAX_TILES) return usage();
+
+  projectSaveDirectory = args[0];
+  if (projectSaveDirectory.back() != '/' && projectSaveDirectory.back() != '\\') projectSaveDirectory += '/';
+  try {
+    Project::load();
+  } catch (const std::exception& e) {
+    fprintf(stderr, "ore-pack: failed to load %s: %s\n", projectSaveDirectory.c_str(), e.what());
+    return LOAD_FAILED;
+  }
+
+  vector<Textures::Atlas*> atlases;
+  try {
+    atlases = Packer::import(args[1], args[2], vec2i(tilesize), grid);
+  } catch (const std::exception& e) {
+    fprintf(stderr, "ore-pack: %s\n", e.what());
+    return PACK_FAILED;
+  }
+  for (const auto atlas : atlases) printf("%s: %dx%d tiles, %d sprites\n", atlas->name.c_str(), atlas->width(), atlas->height(), (int)atlas->sprites.size());
+
+  vector<Saver::Job> jobs;
+  for (const auto atlas : atlases) atlas->save(jobs);
+  std::string failed;
+  Saver::submit(std::move(jobs), projectSaveDirectory + ".save/", [&](const std::string& paths) { failed = paths; });
+  Saver::wait();
+  if (!failed.empty()) return fprintf(stderr, "ore-pack: can't write %s\n", failed.c_str()), SAVE_FAILED;
+  return OK;
+}